@@ -0,0 +1,366 @@
+﻿// file_accumulate.h
+#pragma once
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <fstream>
+#include <functional>
+#include <mutex>
+#include <numeric>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+#include "joining_thread.h"
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// 磁盘上的定长二进制数据集直接做并行归约，不先读进 std::vector：
+// - 文件能放进内存时 mmap 整个文件，按页对齐切块交给各线程，
+//   每个线程处理当前窗口前先对下一个窗口 madvise(MADV_WILLNEED) 预读；
+// - 文件比物理内存大（或 mmap 失败）时退化为 pread 流水线：读线程按顺序填充一组缓冲区，
+//   调用线程和其它工作线程并行归约已经读好的缓冲区，各段结果最后按文件顺序合并。
+// Windows 下没有 mmap/madvise，统一走流水线模式，用 ifstream 读取。
+// 任何线程里抛出的异常（打开或读取失败、op 抛出）都会让其它线程尽快停下，汇合后在调用线程重新抛出。
+enum class file_accumulate_mode {
+    automatic,
+    mmap,
+    pread,
+};
+
+namespace file_accumulate_detail {
+
+// 每个线程每次处理、预读的窗口大小
+constexpr std::size_t window_bytes = 4 * 1024 * 1024;
+// 流水线模式下每个缓冲区的大小
+constexpr std::size_t buffer_bytes = 8 * 1024 * 1024;
+
+inline std::size_t worker_count(std::size_t max_threads) {
+    std::size_t const hardware_threads = std::thread::hardware_concurrency();
+    return std::max<std::size_t>(1, std::min<std::size_t>(hardware_threads != 0 ? hardware_threads : 2, max_threads));
+}
+
+// 记录各线程中第一个异常，汇合后由调用线程重新抛出
+class first_error {
+public:
+    void capture() {
+        std::lock_guard<std::mutex> lock(_mtx);
+        if (!_error) {
+            _error = std::current_exception();
+        }
+    }
+    void rethrow() {
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+private:
+    std::mutex _mtx;
+    std::exception_ptr _error;
+};
+
+// op 只要求满足结合律，不要求有单位元，所以每段从第一个元素开始归约
+template<typename T, typename Op>
+T reduce_range(const T* first, const T* last, Op& op) {
+    T acc = *first;
+    for (++first; first != last; ++first) {
+        acc = op(acc, *first);
+    }
+    return acc;
+}
+
+#ifndef _WIN32
+
+inline std::size_t page_size() {
+    return static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+inline std::uint64_t physical_memory() {
+    long pages = sysconf(_SC_PHYS_PAGES);
+    return pages > 0 ? static_cast<std::uint64_t>(pages) * page_size() : 0;
+}
+
+// 关闭文件描述符的 RAII 包装
+struct scoped_fd {
+    int fd;
+    explicit scoped_fd(const std::string& path) : fd(::open(path.c_str(), O_RDONLY)) {
+        if (fd < 0) {
+            throw std::runtime_error("cannot open " + path);
+        }
+    }
+    ~scoped_fd() {
+        ::close(fd);
+    }
+    scoped_fd(const scoped_fd&) = delete;
+    scoped_fd& operator=(const scoped_fd&) = delete;
+};
+
+// 返回 false 表示 mmap 失败，由调用者退回流水线模式
+template<typename T, typename Op>
+bool accumulate_mmap(int fd, std::size_t count, T& result, Op op) {
+    std::size_t const bytes = count * sizeof(T);
+    void* addr = ::mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (addr == MAP_FAILED) {
+        return false;
+    }
+    ::madvise(addr, bytes, MADV_SEQUENTIAL);
+    const T* data = static_cast<const T*>(addr);
+    const unsigned char* base = static_cast<const unsigned char*>(addr);
+
+    // 块边界既要按页对齐，又要落在元素边界上
+    std::size_t const align = std::lcm(page_size(), sizeof(T));
+    std::size_t const min_per_thread = window_bytes;
+    std::size_t const max_threads = (bytes + min_per_thread - 1) / min_per_thread;
+    std::size_t const num_threads = worker_count(max_threads);
+    std::size_t const block_bytes = (bytes / num_threads + align - 1) / align * align;
+    std::size_t const window = std::max(align, window_bytes / align * align);
+
+    // 函数返回（包括异常）时解除映射
+    struct unmapper {
+        void* addr;
+        std::size_t bytes;
+        ~unmapper() { ::munmap(addr, bytes); }
+    } const unmap{ addr, bytes };
+
+    std::vector<T> results(num_threads);
+    std::vector<char> has_result(num_threads, 0);  // 不用 vector<bool>，各线程写不同字节
+    auto reduce_block = [&](std::size_t i) {
+        std::size_t begin = std::min(bytes, i * block_bytes);
+        std::size_t end = i + 1 == num_threads ? bytes : std::min(bytes, begin + block_bytes);
+        if (begin == end) {
+            return;
+        }
+        T acc{};
+        bool first = true;
+        for (std::size_t win = begin; win < end; win += window) {
+            std::size_t win_end = std::min(end, win + window);
+            // 提前提示内核读入下一个窗口
+            if (win_end < end) {
+                std::size_t ahead = std::min(window, end - win_end);
+                ::madvise(const_cast<unsigned char*>(base) + win_end, ahead, MADV_WILLNEED);
+            }
+            const T* p = data + win / sizeof(T);
+            const T* q = data + win_end / sizeof(T);
+            T part = reduce_range(p, q, op);
+            acc = first ? part : op(acc, part);
+            first = false;
+        }
+        results[i] = acc;
+        has_result[i] = 1;
+    };
+    first_error error;
+    auto worker = [&](std::size_t i) {
+        try {
+            reduce_block(i);
+        }
+        catch (...) {
+            error.capture();
+        }
+    };
+
+    {
+        std::vector<joining_thread> threads;
+        threads.reserve(num_threads - 1);
+        for (std::size_t i = 0; i + 1 < num_threads; ++i) {
+            threads.emplace_back(worker, i);
+        }
+        worker(num_threads - 1);
+    }
+    error.rethrow();
+
+    for (std::size_t i = 0; i < num_threads; ++i) {
+        if (has_result[i]) {
+            result = op(result, results[i]);
+        }
+    }
+    return true;
+}
+
+#endif
+
+#ifndef _WIN32
+using input_file = int;   // 调用者持有的文件描述符
+#else
+using input_file = std::ifstream;
+#endif
+
+// 从 offset 个元素处读 n 个元素，返回是否读满
+template<typename T>
+bool read_elements(input_file& file, std::size_t offset, std::size_t n, T* dst) {
+    std::size_t const want = n * sizeof(T);
+    char* out = reinterpret_cast<char*>(dst);
+    std::size_t got = 0;
+#ifndef _WIN32
+    while (got < want) {
+        ssize_t r = ::pread(file, out + got, want - got, static_cast<off_t>(offset * sizeof(T) + got));
+        if (r <= 0) break;
+        got += static_cast<std::size_t>(r);
+    }
+#else
+    file.read(out, static_cast<std::streamsize>(want));
+    got = static_cast<std::size_t>(file.gcount());
+#endif
+    return got == want;
+}
+
+// 流水线：读线程按顺序把各段读进空闲缓冲区，num_threads 个归约线程（包括调用线程）
+// 各取一个读好的缓冲区归约，结果按段号存放，最后按顺序合并，因此 op 只需满足结合律。
+// 缓冲区比归约线程多一个，读线程可以领先一段
+template<typename T, typename Op>
+T accumulate_pipeline(input_file& file, const std::string& path, std::size_t count, T init, Op op) {
+    std::size_t const per_buffer = std::max<std::size_t>(1, buffer_bytes / sizeof(T));
+    std::size_t const segments = (count + per_buffer - 1) / per_buffer;
+    std::size_t const num_threads = worker_count(segments);
+
+    struct filled_buffer {
+        std::size_t buffer;
+        std::size_t segment;
+    };
+    std::vector<std::vector<T>> buffers(num_threads + 1, std::vector<T>(per_buffer));
+    std::vector<std::size_t> free_buffers;
+    for (std::size_t i = 0; i < buffers.size(); ++i) {
+        free_buffers.push_back(i);
+    }
+    std::deque<filled_buffer> ready;
+    bool reading_done = false;
+    bool stop = false;           // 出错后让所有线程尽快退出
+    std::vector<T> partials(segments);
+    std::mutex mtx;
+    std::condition_variable cv;
+    first_error error;
+
+    auto fail = [&]() {
+        error.capture();
+        std::lock_guard<std::mutex> lock(mtx);
+        stop = true;
+        cv.notify_all();
+    };
+
+    auto read_all = [&]() {
+        try {
+            for (std::size_t seg = 0; seg < segments; ++seg) {
+                std::size_t b;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&] { return stop || !free_buffers.empty(); });
+                    if (stop) {
+                        return;
+                    }
+                    b = free_buffers.back();
+                    free_buffers.pop_back();
+                }
+                std::size_t const offset = seg * per_buffer;
+                std::size_t const n = std::min(per_buffer, count - offset);
+                if (!read_elements(file, offset, n, buffers[b].data())) {
+                    throw std::runtime_error("short read from " + path);
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                ready.push_back(filled_buffer{ b, seg });
+                cv.notify_all();
+            }
+            std::lock_guard<std::mutex> lock(mtx);
+            reading_done = true;
+            cv.notify_all();
+        }
+        catch (...) {
+            fail();
+        }
+    };
+
+    auto reduce_all = [&]() {
+        try {
+            for (;;) {
+                filled_buffer item;
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    cv.wait(lock, [&] { return stop || !ready.empty() || reading_done; });
+                    if (stop || ready.empty()) {
+                        return;
+                    }
+                    item = ready.front();
+                    ready.pop_front();
+                }
+                std::size_t const n = std::min(per_buffer, count - item.segment * per_buffer);
+                const T* data = buffers[item.buffer].data();
+                partials[item.segment] = reduce_range(data, data + n, op);
+                std::lock_guard<std::mutex> lock(mtx);
+                free_buffers.push_back(item.buffer);
+                cv.notify_all();
+            }
+        }
+        catch (...) {
+            fail();
+        }
+    };
+
+    {
+        // 作用域结束时 joining_thread 汇合所有线程，出错路径也一样
+        joining_thread reader(read_all);
+        std::vector<joining_thread> workers;
+        workers.reserve(num_threads - 1);
+        try {
+            for (std::size_t i = 0; i + 1 < num_threads; ++i) {
+                workers.emplace_back(reduce_all);
+            }
+        }
+        catch (...) {
+            fail();
+        }
+        reduce_all();
+    }
+    error.rethrow();
+    for (const T& part : partials) {
+        init = op(init, part);
+    }
+    return init;
+}
+
+}
+
+// 把 path 当作 T 的数组做归约，结尾不足一个元素的字节被忽略
+template<typename T, typename Op = std::plus<T>>
+T parallel_accumulate_file(const std::string& path, T init, Op op = Op(),
+    file_accumulate_mode mode = file_accumulate_mode::automatic) {
+    static_assert(std::is_trivially_copyable<T>::value, "file elements must be trivially copyable");
+    using namespace file_accumulate_detail;
+#ifndef _WIN32
+    scoped_fd file(path);
+    struct stat st;
+    if (::fstat(file.fd, &st) != 0) {
+        throw std::runtime_error("cannot stat " + path);
+    }
+    std::size_t const count = static_cast<std::size_t>(st.st_size) / sizeof(T);
+    if (count == 0) {
+        return init;
+    }
+    std::uint64_t const ram = physical_memory();
+    bool const use_mmap = mode == file_accumulate_mode::mmap
+        || (mode == file_accumulate_mode::automatic && (ram == 0 || static_cast<std::uint64_t>(st.st_size) < ram));
+    if (use_mmap && accumulate_mmap(file.fd, count, init, op)) {
+        return init;
+    }
+    ::posix_fadvise(file.fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+    input_file input = file.fd;
+#else
+    std::ifstream input(path, std::ios::binary | std::ios::ate);
+    if (!input) {
+        throw std::runtime_error("cannot open " + path);
+    }
+    std::size_t const count = static_cast<std::size_t>(input.tellg()) / sizeof(T);
+    if (count == 0) {
+        return init;
+    }
+    input.seekg(0);
+#endif
+    return accumulate_pipeline(input, path, count, init, op);
+}
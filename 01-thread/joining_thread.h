@@ -0,0 +1,75 @@
+﻿// joining_thread.h
+#pragma once
+
+#include "../common/trace.h"
+#include <functional>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+// joining_thread 类，线程包装器，确保析构时自动 join
+// 开启追踪时记录：创建线程（flow 箭头连到新线程）、线程体的执行区间、join 的等待区间
+class joining_thread {
+    std::thread  _t;
+public:
+    joining_thread() noexcept = default;
+
+    template<typename Callable, typename ... Args,
+        typename = typename std::enable_if<!std::is_same<typename std::decay<Callable>::type, std::thread>::value
+        && !std::is_same<typename std::decay<Callable>::type, joining_thread>::value>::type>
+    explicit  joining_thread(Callable&& func, Args&& ...args) :
+        _t(run<typename std::decay<Callable>::type, typename std::decay<Args>::type...>,
+            trace_spawn(), std::forward<Callable>(func), std::forward<Args>(args)...) {}
+
+    explicit joining_thread(std::thread  t) noexcept : _t(std::move(t)) {}
+
+    joining_thread(joining_thread&& other) noexcept : _t(std::move(other._t)) {}
+
+    joining_thread& operator=(joining_thread&& other) noexcept {
+        //如果当前线程可汇合，则汇合等待线程完成再赋值
+        if (joinable()) {
+            join();
+        }
+        _t = std::move(other._t);
+        return *this;
+    }
+
+    ~joining_thread() noexcept {
+        if (joinable()) {
+            join();
+        }
+    }
+
+    bool joinable() const noexcept {
+        return _t.joinable();
+    }
+
+    void join() {
+        std::uint64_t const begin = trace::now();
+        _t.join();
+        trace::complete("join", "thread", begin);
+    }
+
+    std::thread::id get_id() const noexcept {
+        return _t.get_id();
+    }
+
+private:
+    // std::thread 按值（decay）保存可调用对象和参数，这里只是在调用外面加上追踪区间，不多做分配
+    template<typename Callable, typename ... Args>
+    static void run(std::uint64_t spawn_id, Callable func, Args ...args) {
+        trace::scope span("joining_thread", "thread", spawn_id);
+        trace::flow_end("spawn", "thread", spawn_id);
+        std::invoke(std::move(func), std::move(args)...);
+    }
+
+    // 追踪关闭时返回 0，新线程据此不记录 flow 终点
+    static std::uint64_t trace_spawn() {
+        if (!trace::enabled()) {
+            return 0;
+        }
+        std::uint64_t const id = trace::next_id();
+        trace::flow_begin("spawn", "thread", id);
+        return id;
+    }
+};
@@ -1,9 +1,43 @@
 // main.cpp
 #include <iostream>
+#include <cstring>
 #include "utils.h"
+#include "../common/trace.h"
 
-int main() {
-    day01();  //  day01 ʾ
-    //day02();  //  day02 ʾ
-    return 0;
+// ͨвѡʾ day01-thread day02ʱ day01
+//  --trace=PATH ʱ̴߳join ͸ۼӵʱд PATHChrome trace JSON Perfetto 򿪣
+struct demo_entry {
+    const char* name;
+    void (*fn)();
+};
+
+int main(int argc, char* argv[]) {
+    demo_entry const demos[] = {
+        { "day01", day01 },  //  day01 ʾ
+        { "day02", day02 },  //  day02 ʾ
+        { "use_parallel_acc", use_parallel_acc },
+        { "bench_accumulate_file", bench_accumulate_file },
+    };
+    const char* which = "day01";
+    std::string trace_path;
+    for (int i = 1; i < argc; ++i) {
+        if (std::strncmp(argv[i], "--trace=", 8) == 0) {
+            trace_path = argv[i] + 8;
+        }
+        else {
+            which = argv[i];
+        }
+    }
+    for (const auto& demo : demos) {
+        if (std::strcmp(demo.name, which) == 0) {
+            trace::session session(trace_path);
+            demo.fn();
+            return 0;
+        }
+    }
+    std::cerr << "unknown demo " << which << ", available:" << std::endl;
+    for (const auto& demo : demos) {
+        std::cerr << "  " << demo.name << std::endl;
+    }
+    return 1;
 }
@@ -1,5 +1,7 @@
 // parallel_accumulate.cpp
 #include "utils.h"
+#include "joining_thread.h"
+#include "parallel_accumulate.h"
 #include <vector>
 #include <numeric>
 #include <thread>
@@ -28,33 +30,6 @@ void dangerous_use() {
     std::this_thread::sleep_for(std::chrono::seconds(2000));
 }
 
-// joining_thread ̰࣬߳װȷʱԶ join
-class joining_thread {
-    std::thread  _t;
-public:
-    joining_thread() noexcept = default;
-
-    template<typename Callable, typename ... Args>
-    explicit  joining_thread(Callable&& func, Args&& ...args) :
-        _t(std::forward<Callable>(func), std::forward<Args>(args)...) {}
-
-    explicit joining_thread(std::thread  t) noexcept : _t(std::move(t)) {}
-
-    ~joining_thread() noexcept {
-        if (joinable()) {
-            join();
-        }
-    }
-
-    bool joinable() const noexcept {
-        return _t.joinable();
-    }
-
-    void join() {
-        _t.join();
-    }
-};
-
 // ʹ joining_thread ʾ
 void use_jointhread() {
     joining_thread j1([](int maxindex) {
@@ -66,36 +41,6 @@ void use_jointhread() {
 }
 
 
-template<typename Iterator, typename T>
-T parallel_accumulate(Iterator first, Iterator last, T init) {
-    unsigned long const length = std::distance(first, last);
-    if (!length)
-        return init;
-
-    unsigned long const min_per_thread = 25;
-    unsigned long const max_threads = (length + min_per_thread - 1) / min_per_thread;
-    unsigned long const hardware_threads = std::thread::hardware_concurrency();
-    unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
-    unsigned long const block_size = length / num_threads;
-
-    std::vector<T> results(num_threads);
-    std::vector<std::thread> threads(num_threads - 1);
-
-    Iterator block_start = first;
-    for (unsigned long i = 0; i < (num_threads - 1); ++i) {
-        Iterator block_end = block_start;
-        std::advance(block_end, block_size);
-        threads[i] = std::thread([=, &results]() {
-            results[i] = std::accumulate(block_start, block_end, 0);
-            });
-        block_start = block_end;
-    }
-    std::accumulate(block_start, last, results[num_threads - 1]);
-
-    for (auto& entry : threads) entry.join();
-    return std::accumulate(results.begin(), results.end(), init);
-}
-
 void use_parallel_acc() {
     std::vector<int> vec(10000);
     std::iota(vec.begin(), vec.end(), 0);
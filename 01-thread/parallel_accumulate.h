@@ -0,0 +1,50 @@
+﻿// parallel_accumulate.h
+#pragma once
+
+#include <algorithm>
+#include <iterator>
+#include <numeric>
+#include <thread>
+#include <vector>
+#include "../common/trace.h"
+
+// 把区间切成若干块，每块交给一个线程累加，最后汇总各块结果
+// max_threads_hint 为 0 时按硬件线程数切分，基准测试用它扫描不同线程数
+// 开启追踪时每块的累加和最后的 join 各记录一个 span，参数为块号
+template<typename Iterator, typename T>
+T parallel_accumulate(Iterator first, Iterator last, T init, unsigned long max_threads_hint = 0) {
+    unsigned long const length = std::distance(first, last);
+    if (!length)
+        return init;
+
+    unsigned long const min_per_thread = 25;
+    unsigned long const max_threads = (length + min_per_thread - 1) / min_per_thread;
+    unsigned long const hardware_threads = max_threads_hint != 0 ? max_threads_hint : std::thread::hardware_concurrency();
+    unsigned long const num_threads = std::min(hardware_threads != 0 ? hardware_threads : 2, max_threads);
+    unsigned long const block_size = length / num_threads;
+
+    std::vector<T> results(num_threads);
+    std::vector<std::thread> threads(num_threads - 1);
+
+    Iterator block_start = first;
+    for (unsigned long i = 0; i < (num_threads - 1); ++i) {
+        Iterator block_end = block_start;
+        std::advance(block_end, block_size);
+        threads[i] = std::thread([=, &results]() {
+            trace::scope span("block", "parallel_accumulate", i);
+            results[i] = std::accumulate(block_start, block_end, T());
+            });
+        block_start = block_end;
+    }
+    // 最后一块由当前线程计算，结果要写回 results
+    {
+        trace::scope span("block", "parallel_accumulate", num_threads - 1);
+        results[num_threads - 1] = std::accumulate(block_start, last, T());
+    }
+
+    {
+        trace::scope span("join", "parallel_accumulate");
+        for (auto& entry : threads) entry.join();
+    }
+    return std::accumulate(results.begin(), results.end(), init);
+}
@@ -0,0 +1,105 @@
+﻿// task_arena.h
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+// 每个线程一块的线性（bump）分配区，给放不进 unique_task 内联缓冲的大捕获使用。
+// 任务通常在一个线程创建、在另一个线程执行和销毁，所以每个块带一个原子引用计数：
+// 块里每个存活对象持有一个引用，创建线程的当前块额外持有一个，计数归零时整块释放。
+class task_arena {
+public:
+    static constexpr std::size_t chunk_size = 64 * 1024;
+    // 超过这个大小的对象直接走 operator new，避免浪费整块
+    static constexpr std::size_t max_block = chunk_size / 4;
+
+    static void* allocate(std::size_t size, std::size_t align) {
+        if (align > alignof(std::max_align_t)) {
+            // 超对齐对象：按 align 对齐分配，块头放在对象前面 align 字节的位置里，对象本身也就对齐了
+            unsigned char* base = static_cast<unsigned char*>(::operator new(align + size, std::align_val_t(align)));
+            header* h = reinterpret_cast<header*>(base + align - header_size);
+            h->owner = nullptr;
+            h->align = align;
+            return base + align;
+        }
+        if (size > max_block) {
+            header* h = static_cast<header*>(::operator new(header_size + size));
+            h->owner = nullptr;
+            h->align = 0;
+            return reinterpret_cast<unsigned char*>(h) + header_size;
+        }
+        std::size_t need = header_size + round_up(size);
+        chunk*& cur = local().cur;
+        if (cur == nullptr || cur->used + need > chunk_size - sizeof(chunk)) {
+            if (cur != nullptr) {
+                release(cur);
+            }
+            cur = new (::operator new(chunk_size)) chunk();
+        }
+        header* h = reinterpret_cast<header*>(cur->data() + cur->used);
+        h->owner = cur;
+        cur->used += need;
+        cur->refs.fetch_add(1, std::memory_order_relaxed);
+        return reinterpret_cast<unsigned char*>(h) + header_size;
+    }
+
+    // 可以在任意线程调用
+    static void deallocate(void* p) noexcept {
+        header* h = reinterpret_cast<header*>(static_cast<unsigned char*>(p) - header_size);
+        if (h->owner == nullptr) {
+            if (h->align != 0) {
+                ::operator delete(static_cast<unsigned char*>(p) - h->align, std::align_val_t(h->align));
+            }
+            else {
+                ::operator delete(h);
+            }
+            return;
+        }
+        release(h->owner);
+    }
+
+private:
+    // 对齐到 max_align_t，保证块头之后的数据区同样对齐
+    struct alignas(std::max_align_t) chunk {
+        std::atomic<std::size_t> refs{ 1 };  // 创建线程持有的引用
+        std::size_t used = 0;
+        unsigned char* data() {
+            return reinterpret_cast<unsigned char*>(this) + sizeof(chunk);
+        }
+    };
+
+    // owner 为空表示单独分配；此时 align 非零表示按 align 对齐分配
+    struct alignas(std::max_align_t) header {
+        chunk* owner;
+        std::size_t align;
+    };
+    static constexpr std::size_t header_size = sizeof(header);
+
+    // 线程退出时放弃对当前块的引用
+    struct local_state {
+        chunk* cur = nullptr;
+        ~local_state() {
+            if (cur != nullptr) {
+                release(cur);
+            }
+        }
+    };
+
+    static local_state& local() {
+        thread_local local_state state;
+        return state;
+    }
+
+    static std::size_t round_up(std::size_t n) {
+        std::size_t const a = alignof(std::max_align_t);
+        return (n + a - 1) / a * a;
+    }
+
+    static void release(chunk* c) noexcept {
+        if (c->refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            c->~chunk();
+            ::operator delete(c);
+        }
+    }
+};
@@ -0,0 +1,125 @@
+﻿// task_bench.cpp
+// 统计线程启动 / 任务提交的延迟和每个任务的堆分配次数。
+// 这里替换了全局 operator new，所以是一个单独的程序，不和其它示例链接在一起
+#include "utils.h"
+#include "joining_thread.h"
+#include "thread_pool.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <functional>
+#include <new>
+
+// 计数版 operator new，统计整个程序的堆分配次数
+static std::atomic<std::size_t> g_alloc_count{ 0 };
+
+void* operator new(std::size_t size) {
+    g_alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+namespace {
+
+// 48 字节的捕获：std::function 的小对象缓冲放不下，unique_task 可以内联
+struct medium_capture {
+    long values[6];
+    void operator()() const {
+        volatile long sum = values[0] + values[5];
+        (void)sum;
+    }
+};
+
+// 256 字节的捕获：超过内联缓冲，走 task_arena
+struct large_capture {
+    long values[32];
+    void operator()() const {
+        volatile long sum = values[0] + values[31];
+        (void)sum;
+    }
+};
+
+void launch_target(int i, const medium_capture& c) {
+    volatile long sum = i + c.values[0];
+    (void)sum;
+}
+
+template<typename Fn>
+void report(const char* name, int n, Fn&& fn) {
+    std::size_t allocs_before = g_alloc_count.load();
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < n; ++i) {
+        fn(i);
+    }
+    auto end = std::chrono::steady_clock::now();
+    std::size_t allocs = g_alloc_count.load() - allocs_before;
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+    std::cout << name << ": " << ns / n << " ns/task, "
+        << static_cast<double>(allocs) / n << " allocs/task" << std::endl;
+}
+
+}
+
+void bench_unique_task() {
+    int const n = 100000;
+
+    // 单纯构造并调用可调用对象包装
+    report("std::function medium", n, [](int i) {
+        std::function<void()> f(medium_capture{ { i } });
+        f();
+        });
+    report("unique_task medium", n, [](int i) {
+        unique_task t(medium_capture{ { i } });
+        t();
+        });
+    report("std::function large", n, [](int i) {
+        std::function<void()> f(large_capture{ { i } });
+        f();
+        });
+    report("unique_task large", n, [](int i) {
+        unique_task t(large_capture{ { i } });
+        t();
+        });
+    // make_unique 本身的一次分配计入结果，包装不再额外分配
+    report("unique_task unique_ptr", n, [](int i) {
+        auto p = std::make_unique<int>(i);
+        unique_task t([p = std::move(p)]() { (*p)++; });
+        t();
+        });
+
+    // 启动线程：std::thread 自身的状态块无法避免，比较的是额外的参数拷贝
+    int const launches = 2000;
+    report("std::thread launch", launches, [](int i) {
+        std::thread t(launch_target, i, medium_capture{ { i } });
+        t.join();
+        });
+    report("joining_thread launch", launches, [](int i) {
+        joining_thread t(launch_target, i, medium_capture{ { i } });
+        });
+
+    // 线程池提交：环形数组预分配，稳定状态下每个任务零分配
+    {
+        thread_pool pool(2, 4096);
+        report("thread_pool submit medium", n, [&pool](int i) {
+            pool.submit(medium_capture{ { i } });
+            });
+        report("thread_pool submit large", n, [&pool](int i) {
+            pool.submit(large_capture{ { i } });
+            });
+    }
+}
+
+int main() {
+    bench_unique_task();
+    return 0;
+}
@@ -1,8 +1,11 @@
 ﻿// thread_examples.cpp
 #include "utils.h"
 #include "joining_thread.h"
+#include "../common/trace.h"
 #include <thread>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 
 // print_str 函数定义
 void print_str(int i, const std::string& s) {
@@ -53,7 +56,7 @@ void catch_exception() {
 // 错误示例：detach 后访问局部变量，可能导致崩溃
 void danger_oops(int som_param) {
     char buffer[1024];
-    sprintf_s(buffer, "%i", som_param);
+    std::snprintf(buffer, sizeof(buffer), "%i", som_param);
     std::thread t(print_str, 3, buffer);
     t.detach();
     std::cout << "danger oops finished " << std::endl;
@@ -62,7 +65,7 @@ void danger_oops(int som_param) {
 // 安全示例：在创建线程前转换为 std::string 确保线程安全
 void safe_oops(int some_param) {
     char buffer[1024];
-    sprintf_s(buffer, "%i", some_param);
+    std::snprintf(buffer, sizeof(buffer), "%i", some_param);
     std::thread t(print_str, 3, std::string(buffer));
     t.detach();
 }
@@ -91,10 +94,13 @@ class thread_guard {
 private:
     std::thread& _t;
 public:
-    explicit thread_guard(std::thread& t) :_t(t) {}
+    explicit thread_guard(std::thread& t) :_t(t) {
+        trace::instant("thread_guard", "thread");
+    }
     ~thread_guard() {
         //join只能调用一次
         if (_t.joinable()) {
+            trace::scope span("join", "thread");
             _t.join();
         }
     }
@@ -167,5 +173,7 @@ void day01() {
     //std::this_thread::sleep_for(std::chrono::seconds(2));
 
 
+#ifdef _WIN32
     system("pause");
+#endif
 }
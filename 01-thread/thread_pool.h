@@ -0,0 +1,105 @@
+﻿// thread_pool.h
+#pragma once
+
+#include "joining_thread.h"
+#include "unique_task.h"
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <iostream>
+#include <vector>
+#include <cstddef>
+
+// 固定线程数的简单线程池。任务队列是预分配的 unique_task 环形数组，
+// 小任务提交时不做任何堆分配；队列满时 submit 阻塞。
+// 任务抛出的异常由工作线程捕获并打印到 std::cerr，不会终止进程，也不会传回 submit 的调用方。
+class thread_pool {
+public:
+    explicit thread_pool(std::size_t threads = default_threads(), std::size_t capacity = 1024) :
+        _tasks(capacity), _capacity(capacity) {
+        _workers.reserve(threads);
+        try {
+            for (std::size_t i = 0; i < threads; ++i) {
+                _workers.emplace_back(&thread_pool::worker_loop, this);
+            }
+        }
+        catch (...) {
+            // 创建线程失败：先让已经启动的工作线程退出，否则 _workers 析构时 join 会永远等下去
+            stop();
+            throw;
+        }
+    }
+
+    thread_pool(const thread_pool&) = delete;
+    thread_pool& operator=(const thread_pool&) = delete;
+
+    // 停止接收任务，已提交的任务执行完后工作线程退出，_workers 析构时自动 join
+    ~thread_pool() {
+        stop();
+    }
+
+    template<typename F>
+    void submit(F&& f) {
+        // 在锁外构造任务，缩短临界区
+        unique_task task(std::forward<F>(f));
+        {
+            std::unique_lock<std::mutex> lock(_mtx);
+            _not_full.wait(lock, [this] { return _tail - _head < _capacity; });
+            _tasks[_tail++ % _capacity] = std::move(task);
+        }
+        _not_empty.notify_one();
+    }
+
+    std::size_t size() const {
+        return _workers.size();
+    }
+
+private:
+    void stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mtx);
+            _stop = true;
+        }
+        _not_empty.notify_all();
+    }
+
+    static std::size_t default_threads() {
+        unsigned const n = std::thread::hardware_concurrency();
+        return n != 0 ? n : 2;
+    }
+
+    void worker_loop() {
+        for (;;) {
+            unique_task task;
+            {
+                std::unique_lock<std::mutex> lock(_mtx);
+                _not_empty.wait(lock, [this] { return _stop || _head != _tail; });
+                if (_head == _tail) {
+                    return;
+                }
+                task = std::move(_tasks[_head++ % _capacity]);
+            }
+            _not_full.notify_one();
+            try {
+                task();
+            }
+            catch (const std::exception& e) {
+                std::cerr << "thread_pool: task threw: " << e.what() << std::endl;
+            }
+            catch (...) {
+                std::cerr << "thread_pool: task threw an unknown exception" << std::endl;
+            }
+        }
+    }
+
+    std::mutex _mtx;
+    std::condition_variable _not_empty;
+    std::condition_variable _not_full;
+    std::vector<unique_task> _tasks;
+    std::size_t const _capacity;
+    std::size_t _head = 0;
+    std::size_t _tail = 0;
+    bool _stop = false;
+    // 放在最后，析构时最先 join 工作线程，此时其它成员仍然有效
+    std::vector<joining_thread> _workers;
+};
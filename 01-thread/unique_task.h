@@ -0,0 +1,143 @@
+﻿// unique_task.h
+#pragma once
+
+#include "task_arena.h"
+#include <cstddef>
+#include <functional>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+// 只能移动的 void() 可调用对象包装，类似 std::function，但是：
+// 1. 可以保存 unique_ptr 之类只能移动的捕获；
+// 2. 带 64 字节内联缓冲，小的可调用对象直接放在缓冲里，不做任何堆分配；
+// 3. 放不下的大捕获从当前线程的 task_arena 中分配。
+class unique_task {
+public:
+    static constexpr std::size_t inline_size = 64;
+
+    unique_task() noexcept = default;
+
+    template<typename F,
+        typename = typename std::enable_if<!std::is_same<typename std::decay<F>::type, unique_task>::value>::type>
+    unique_task(F&& f) {
+        using fn_type = typename std::decay<F>::type;
+        if constexpr (fits_inline<fn_type>()) {
+            new (_buf) fn_type(std::forward<F>(f));
+            _vt = &inline_ops<fn_type>::table;
+        }
+        else {
+            void* mem = task_arena::allocate(sizeof(fn_type), alignof(fn_type));
+            try {
+                *reinterpret_cast<fn_type**>(_buf) = new (mem) fn_type(std::forward<F>(f));
+            }
+            catch (...) {
+                task_arena::deallocate(mem);
+                throw;
+            }
+            _vt = &arena_ops<fn_type>::table;
+        }
+    }
+
+    unique_task(unique_task&& other) noexcept : _vt(other._vt) {
+        if (_vt != nullptr) {
+            _vt->move(_buf, other._buf);
+            other._vt = nullptr;
+        }
+    }
+
+    unique_task& operator=(unique_task&& other) noexcept {
+        if (this != &other) {
+            reset();
+            if (other._vt != nullptr) {
+                other._vt->move(_buf, other._buf);
+                _vt = other._vt;
+                other._vt = nullptr;
+            }
+        }
+        return *this;
+    }
+
+    unique_task(const unique_task&) = delete;
+    unique_task& operator=(const unique_task&) = delete;
+
+    ~unique_task() {
+        reset();
+    }
+
+    explicit operator bool() const noexcept {
+        return _vt != nullptr;
+    }
+
+    // 与 std::function 一样，调用空的（或已被移走的）任务抛出 bad_function_call
+    void operator()() {
+        if (_vt == nullptr) {
+            throw std::bad_function_call();
+        }
+        _vt->invoke(_buf);
+    }
+
+    void reset() noexcept {
+        if (_vt != nullptr) {
+            _vt->destroy(_buf);
+            _vt = nullptr;
+        }
+    }
+
+    // 可调用对象是否直接存放在内联缓冲中（基准测试和调试用）
+    template<typename F>
+    static constexpr bool fits_inline() {
+        return sizeof(F) <= inline_size
+            && alignof(F) <= alignof(std::max_align_t)
+            && std::is_nothrow_move_constructible<F>::value;
+    }
+
+private:
+    struct ops {
+        void (*invoke)(void* buf);
+        void (*move)(void* dst, void* src) noexcept;
+        void (*destroy)(void* buf) noexcept;
+    };
+
+    template<typename F>
+    struct inline_ops {
+        static void invoke(void* buf) {
+            (*static_cast<F*>(buf))();
+        }
+        static void move(void* dst, void* src) noexcept {
+            F* s = static_cast<F*>(src);
+            new (dst) F(std::move(*s));
+            s->~F();
+        }
+        static void destroy(void* buf) noexcept {
+            static_cast<F*>(buf)->~F();
+        }
+        static constexpr ops table = { &invoke, &move, &destroy };
+    };
+
+    // 缓冲里只存一个指向 arena 中对象的指针，移动时只拷贝指针
+    template<typename F>
+    struct arena_ops {
+        static void invoke(void* buf) {
+            (**static_cast<F**>(buf))();
+        }
+        static void move(void* dst, void* src) noexcept {
+            *static_cast<F**>(dst) = *static_cast<F**>(src);
+        }
+        static void destroy(void* buf) noexcept {
+            F* p = *static_cast<F**>(buf);
+            p->~F();
+            task_arena::deallocate(p);
+        }
+        static constexpr ops table = { &invoke, &move, &destroy };
+    };
+
+    alignas(std::max_align_t) unsigned char _buf[inline_size];
+    const ops* _vt = nullptr;
+};
+
+template<typename F>
+constexpr unique_task::ops unique_task::inline_ops<F>::table;
+
+template<typename F>
+constexpr unique_task::ops unique_task::arena_ops<F>::table;
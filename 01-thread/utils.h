@@ -48,4 +48,7 @@ void use_parallel_acc();
 
 // day02 
 void day02();
+
+// file_accumulate_bench.cpp
+void bench_accumulate_file();
 #endif
@@ -0,0 +1,119 @@
+﻿// big_object.h
+#pragma once
+
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../../common/trace.h"
+
+//假设这是一个很复杂的数据结构, 假设不建议拷贝操作
+//真正的数据放在堆上的 impl 中，对象本身只是一个指针句柄：
+//移动和交换只交换指针，是 O(1) 且 noexcept 的，与负载大小无关
+class som_big_object {
+public:
+	som_big_object(int data, std::size_t payload_size = 0) :_impl(std::make_unique<impl>(data, payload_size)) {}
+	//拷贝构造，深拷贝负载
+	som_big_object(const som_big_object& b2) :_impl(b2._impl ? std::make_unique<impl>(*b2._impl) : nullptr) {
+	}
+	//移动构造，只转移指针
+	som_big_object(som_big_object&& b2) noexcept :_impl(std::move(b2._impl)) {
+
+	}
+	//重载输出运算符
+	friend std::ostream& operator << (std::ostream& os, const som_big_object& big_obj) {
+		if (big_obj._impl) {
+			os << big_obj._impl->data;
+		}
+		return os;
+	}
+
+	//重载赋值运算符，先拷贝再交换，异常安全
+	som_big_object& operator = (const som_big_object& b2) {
+		if (this == &b2) {
+			return *this;
+		}
+		som_big_object temp(b2);
+		swap(*this, temp);
+		return *this;
+	}
+
+	//移动赋值，之前缺少它，导致 swap 中的 std::move 退化为两次深拷贝
+	som_big_object& operator = (som_big_object&& b2) noexcept {
+		_impl = std::move(b2._impl);
+		return *this;
+	}
+
+	//交换数据，只交换指针
+	friend void swap(som_big_object& b1, som_big_object& b2) noexcept {
+		b1._impl.swap(b2._impl);
+	}
+
+	std::size_t payload_size() const noexcept {
+		return _impl ? _impl->payload.size() : 0;
+	}
+private:
+	struct impl {
+		impl(int d, std::size_t payload_size) :data(d), payload(payload_size) {}
+		int data;
+		std::vector<char> payload;
+	};
+	std::unique_ptr<impl> _impl;
+};
+
+//假设这是一个结构包含了锁与复杂的成员对象
+//锁用 traced_mutex，开启追踪时可以看到各线程在哪把锁上等待、持有了多久。
+//管理的对象类型是模板参数，基准测试用它把旧版的深拷贝对象放进同样的临界区里比较
+template<typename Obj>
+class basic_object_mgr;
+using big_object_mgr = basic_object_mgr<som_big_object>;
+
+template<typename Obj>
+class basic_object_mgr {
+public:
+	using mutex_type = trace::traced_mutex<>;
+	basic_object_mgr(int data = 0, std::size_t payload_size = 0) :_mtx("big_object_mgr"), _obj(data, payload_size) {}
+	void printinfo() {
+		std::cout << "current obj data is " << _obj << std::endl;
+	}
+	//替换管理的对象：锁内只交换指针，旧对象作为返回值交给调用方，在锁外析构
+	Obj replace(Obj obj) {
+		std::lock_guard<mutex_type> guard(_mtx);
+		swap(_obj, obj);
+		return obj;
+	}
+	//替换并丢掉旧对象，旧对象在锁释放后析构
+	void reset(Obj obj) {
+		replace(std::move(obj));
+	}
+	friend void danger_swap(big_object_mgr& objm1, big_object_mgr& objm2);
+	template<typename T>
+	friend void lock_swap(basic_object_mgr<T>& objm1, basic_object_mgr<T>& objm2);
+	template<typename T>
+	friend void scoped_swap(basic_object_mgr<T>& objm1, basic_object_mgr<T>& objm2);
+private:
+	mutex_type _mtx;
+	Obj _obj;
+};
+
+//safe_swap 的加锁方式，去掉了演示用的打印和睡眠：std::lock 同时加锁，再由 lock_guard 领养
+template<typename Obj>
+void lock_swap(basic_object_mgr<Obj>& objm1, basic_object_mgr<Obj>& objm2) {
+	if (&objm1 == &objm2) {
+		return;
+	}
+	std::lock(objm1._mtx, objm2._mtx);
+	std::lock_guard <typename basic_object_mgr<Obj>::mutex_type> gurad1(objm1._mtx, std::adopt_lock);
+	std::lock_guard <typename basic_object_mgr<Obj>::mutex_type> gurad2(objm2._mtx, std::adopt_lock);
+	swap(objm1._obj, objm2._obj);
+}
+
+//safe_swap_scope 的加锁方式，用 scoped_lock 一次锁住两个互斥量
+template<typename Obj>
+void scoped_swap(basic_object_mgr<Obj>& objm1, basic_object_mgr<Obj>& objm2) {
+	if (&objm1 == &objm2) {
+		return;
+	}
+	std::scoped_lock  guard(objm1._mtx, objm2._mtx);
+	swap(objm1._obj, objm2._obj);
+}
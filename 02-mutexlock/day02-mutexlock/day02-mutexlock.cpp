@@ -4,9 +4,18 @@
 #include <iostream>
 #include <mutex>
 #include <thread>
-#include <stack>
-
-std::mutex  mtx1;// 用于保护共享数据的互斥锁
+#include <memory>
+#include <vector>
+#include <chrono>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+#include "threadsafe_stack.h"
+#include "big_object.h"
+#include "hierarchical_mutex.h"
+#include "../../common/trace.h"
+
+trace::traced_mutex<>  mtx1("mtx1");// 用于保护共享数据的互斥锁
 int shared_data = 100;// 共享数据示例
 
 // 一个循环增加共享数据的线程函数，使用互斥锁来保护共享数据
@@ -22,48 +31,6 @@ void use_lock() {
 
 }
 
-// 线程不安全的栈类模板
-template<typename T>
-class threadsafe_stack1
-{
-private:
-	std::stack<T> data;// 数据栈
-	mutable std::mutex m; // 保护数据栈的互斥锁
-public:
-	threadsafe_stack1() {} // 默认构造函数
-
-	// 拷贝构造函数，确保线程安全
-	threadsafe_stack1(const threadsafe_stack1& other)
-	{
-		// 互斥锁保护
-		std::lock_guard<std::mutex> lock(other.m);
-		//①在构造函数的函数体（constructor body）内进行复制操作
-		data = other.data;
-	}
-	// 禁止赋值操作
-	threadsafe_stack1& operator=(const threadsafe_stack1&) = delete;
-	// 添加元素
-	void push(T new_value)
-	{
-		std::lock_guard<std::mutex> lock(m);
-		data.push(std::move(new_value));
-	}
-
-	// 弹出元素（问题：返回拷贝的栈顶元素）
-	T pop()
-	{
-		std::lock_guard<std::mutex> lock(m);
-		auto element = data.top();
-		data.pop();
-		return element;
-	}
-	// 检查栈是否为空
-	bool empty() const
-	{
-		std::lock_guard<std::mutex> lock(m);
-		return data.empty();
-	}
-};
 // 测试线程不安全栈
 void test_threadsafe_stack1() {
 	threadsafe_stack1<int> safe_stack;
@@ -87,61 +54,7 @@ void test_threadsafe_stack1() {
 	t2.join();
 }
 
-// 自定义异常类，用于空栈的异常处理
-struct empty_stack : std::exception
-{
-	const char* what() const throw()
-	{
-		return "Stack is empty";
-	}
-};
 
-// 改进的线程安全栈，提供异常安全的 pop 方法
-template<typename T>
-class threadsafe_stack
-{
-private:
-	std::stack<T> data;
-	mutable std::mutex m;
-public:
-	threadsafe_stack() {}
-	threadsafe_stack(const threadsafe_stack& other)
-	{
-		std::lock_guard<std::mutex> lock(other.m);
-		//①在构造函数的函数体（constructor body）内进行复制操作
-		data = other.data;   
-	}
-	threadsafe_stack& operator=(const threadsafe_stack&) = delete;
-	void push(T new_value)
-	{
-		std::lock_guard<std::mutex> lock(m);
-		data.push(std::move(new_value));
-	}
-	// 弹出元素并返回 shared_ptr 指针，这里不一样
-	std::shared_ptr<T> pop()
-	{
-		std::lock_guard<std::mutex> lock(m);
-		//②试图弹出前检查是否为空栈
-		if (data.empty()) throw empty_stack();
-		//③改动栈容器前设置返回值
-			std::shared_ptr<T> const res(std::make_shared<T>(data.top()));    
-			data.pop();
-		return res;
-	}
-	// 弹出元素并存储在传入的引用中
-	void pop(T& value)
-	{
-		std::lock_guard<std::mutex> lock(m);
-		if (data.empty()) throw empty_stack();
-		value = data.top();
-		data.pop();
-	}
-	bool empty() const
-	{
-		std::lock_guard<std::mutex> lock(m);
-		return data.empty();
-	}
-};
 // 测试锁和共享数据
 void test_lock() {
 	std::thread t1(use_lock);
@@ -161,8 +74,125 @@ void test_lock() {
 	t2.join();
 }
 
-std::mutex  t_lock1;
-std::mutex  t_lock2;
+// 写者线程不断 push/pop，同时主线程反复做快照，统计快照耗时和写者的最大停顿
+template<typename Stack, typename SnapshotFn>
+void measure_snapshot(const char* name, Stack& stack, std::size_t n, SnapshotFn snapshot_fn)
+{
+	std::atomic<bool> stop(false);
+	std::atomic<bool> started(false);
+	std::chrono::nanoseconds max_stall(0);
+	std::thread writer([&]() {
+		int value = 0;
+		started = true;
+		while (!stop.load(std::memory_order_relaxed)) {
+			auto start = std::chrono::steady_clock::now();
+			stack.push(1);
+			stack.pop(value);
+			auto cost = std::chrono::steady_clock::now() - start;
+			if (cost > max_stall) max_stall = std::chrono::duration_cast<std::chrono::nanoseconds>(cost);
+		}
+		});
+	while (!started) std::this_thread::yield();
+	int const rounds = 10;
+	std::chrono::nanoseconds total(0);
+	for (int i = 0; i < rounds; ++i) {
+		//留出时间让写者在两次快照之间运行
+		std::this_thread::sleep_for(std::chrono::milliseconds(2));
+		auto start = std::chrono::steady_clock::now();
+		snapshot_fn();
+		total += std::chrono::steady_clock::now() - start;
+	}
+	stop = true;
+	writer.join();
+	std::cout << name << " size " << n << ": snapshot " << total.count() / rounds
+		<< " ns, max writer stall " << max_stall.count() << " ns" << std::endl;
+}
+
+void bench_stack_snapshot()
+{
+	std::size_t const sizes[] = { 1000, 10000, 100000, 1000000, 10000000 };
+	for (std::size_t n : sizes) {
+		{
+			threadsafe_stack<int> stack;
+			for (std::size_t i = 0; i < n; ++i) stack.push(static_cast<int>(i));
+			measure_snapshot("threadsafe_stack copy", stack, n, [&stack]() {
+				threadsafe_stack<int> copy(stack);
+				});
+		}
+		{
+			snapshot_stack<int> stack;
+			for (std::size_t i = 0; i < n; ++i) stack.push(static_cast<int>(i));
+			measure_snapshot("snapshot_stack", stack, n, [&stack]() {
+				persistent_stack<int> snap = stack.snapshot();
+				});
+		}
+	}
+}
+
+//并发压力测试：3 个线程各自交替 push/try_pop，另一个线程不停做快照并遍历。
+//每个值只压入一次，检查弹出的值不重复、不丢失，快照的 size() 与遍历到的节点数一致。
+//出错时以非零退出码结束，ctest 里以这个示例作为测试（用 -fsanitize=thread 构建时还能检查数据竞争）
+void stress_snapshot_stack()
+{
+	int const writers = 3;
+	int const per_writer = 200000;
+	snapshot_stack<int> stack;
+	std::vector<std::atomic<int>> popped(static_cast<std::size_t>(writers) * per_writer);
+	std::atomic<bool> done(false);
+	std::atomic<bool> failed(false);
+	auto take = [&](int value) {
+		if (value < 0 || value >= writers * per_writer || popped[value].fetch_add(1) != 0) {
+			failed = true;
+		}
+	};
+	std::vector<std::thread> threads;
+	for (int t = 0; t < writers; ++t) {
+		threads.emplace_back([&, t]() {
+			int value = 0;
+			for (int k = 0; k < per_writer; ++k) {
+				stack.push(t * per_writer + k);
+				//奇数轮不弹出，让栈里始终留有一些节点供快照共享
+				if ((k & 1) == 0 && stack.try_pop(value)) {
+					take(value);
+				}
+			}
+			});
+	}
+	std::size_t snapshots = 0;
+	std::thread reader([&]() {
+		while (!done.load()) {
+			persistent_stack<int> snap = stack.snapshot();
+			std::size_t count = 0;
+			snap.for_each([&count](int) { ++count; });
+			if (count != snap.size()) {
+				failed = true;
+			}
+			++snapshots;
+		}
+		});
+	for (auto& t : threads) {
+		t.join();
+	}
+	done = true;
+	reader.join();
+	int value = 0;
+	while (stack.try_pop(value)) {
+		take(value);
+	}
+	for (const auto& p : popped) {
+		if (p.load() != 1) {
+			failed = true;
+		}
+	}
+	std::cout << "snapshot_stack stress: " << snapshots << " snapshots, "
+		<< (failed ? "FAILED" : "ok") << std::endl;
+	if (failed) {
+		std::exit(EXIT_FAILURE);
+	}
+}
+
+trace::traced_mutex<>  t_lock1("t_lock1");
+trace::traced_mutex<>  t_lock2("t_lock2");
 int m_1 = 0;
 int m_2 = 1;
 
@@ -244,67 +274,16 @@ void test_safe_lock() {
 
 //对于要使用两个互斥量，可以同时加锁，如不同时加锁可能会存在问题
 
-//假设这是一个很复杂的数据结构, 假设不建议拷贝操作
-class som_big_object {
-public:
-	som_big_object(int data) :_data(data) {}
-	//拷贝构造
-	som_big_object(const som_big_object& b2) :_data(b2._data) {
-		_data = b2._data;
-	}
-	//移动构造
-	som_big_object(som_big_object&& b2) :_data(std::move(b2._data)) {
-
-	}
-	//重载输出运算符
-	friend std::ostream& operator << (std::ostream& os, const som_big_object& big_obj) {
-		os << big_obj._data;
-		return os;
-	}
-
-	//重载赋值运算符
-	som_big_object& operator = (const som_big_object& b2) {
-		if (this == &b2) {
-			return *this;
-		}
-		_data = b2._data;
-		return *this;
-	}
-
-	//交换数据
-	friend void swap(som_big_object& b1, som_big_object& b2) {
-		som_big_object temp = std::move(b1);
-		b1 = std::move(b2);
-		b2 = std::move(temp);
-	}
-private:
-	int _data;
-};
-
-//假设这是一个结构包含了锁与复杂的成员对象
-class big_object_mgr {
-public:
-	big_object_mgr(int data = 0) :_obj(data) {}
-	void printinfo() {
-		std::cout << "current obj data is " << _obj << std::endl;
-	}
-	friend void danger_swap(big_object_mgr& objm1, big_object_mgr& objm2);
-	friend void safe_swap(big_object_mgr& objm1, big_object_mgr& objm2);
-	friend void safe_swap_scope(big_object_mgr& objm1, big_object_mgr& objm2);
-private:
-	std::mutex _mtx;
-	som_big_object _obj;
-};
 
 void danger_swap(big_object_mgr& objm1, big_object_mgr& objm2) {
 	std::cout << "thread [ " << std::this_thread::get_id() << " ] begin" << std::endl;
 	if (&objm1 == &objm2) {
 		return;
 	}
-	std::lock_guard <std::mutex> gurad1(objm1._mtx);
+	std::lock_guard <big_object_mgr::mutex_type> gurad1(objm1._mtx);
 	//此处为了故意制造死锁，我们让线程小睡一会
 	std::this_thread::sleep_for(std::chrono::seconds(1));
-	std::lock_guard<std::mutex> guard2(objm2._mtx);
+	std::lock_guard<big_object_mgr::mutex_type> guard2(objm2._mtx);
 	swap(objm1._obj, objm2._obj);
 	std::cout << "thread [ " << std::this_thread::get_id() << " ] end" << std::endl;
 }
@@ -330,17 +309,9 @@ void safe_swap(big_object_mgr& objm1, big_object_mgr& objm2) {
 		return;
 	}
 
-	//更改处同时加锁！
-	std::lock(objm1._mtx, objm2._mtx);
-	//领养锁管理它自动释放
-	std::lock_guard <std::mutex> gurad1(objm1._mtx, std::adopt_lock);
-
-	//此处为了故意制造死锁，我们让线程小睡一会
-	std::this_thread::sleep_for(std::chrono::seconds(1));
-
-	std::lock_guard <std::mutex> gurad2(objm2._mtx, std::adopt_lock);
-
-	swap(objm1._obj, objm2._obj);
+	//lock_swap 内部用 std::lock(objm1._mtx, objm2._mtx) 同时加锁，
+	//再用两个 std::lock_guard<big_object_mgr::mutex_type>(..., std::adopt_lock) 领养，离开作用域时自动释放
+	lock_swap(objm1, objm2);
 	std::cout << "thread [ " << std::this_thread::get_id() << " ] end" << std::endl;
 }
 
@@ -351,10 +322,10 @@ void safe_swap_scope(big_object_mgr& objm1, big_object_mgr& objm2) {
 		return;
 	}
 
-	std::scoped_lock  guard(objm1._mtx, objm2._mtx);
+	//scoped_swap 内部为 std::scoped_lock  guard(objm1._mtx, objm2._mtx);
 	//等价于
-	//std::scoped_lock<std::mutex, std::mutex> guard(objm1._mtx, objm2._mtx);
-	swap(objm1._obj, objm2._obj);
+	//std::scoped_lock<big_object_mgr::mutex_type, big_object_mgr::mutex_type> guard(objm1._mtx, objm2._mtx);
+	scoped_swap(objm1, objm2);
 	std::cout << "thread [ " << std::this_thread::get_id() << " ] end" << std::endl;
 }
 
@@ -384,58 +355,88 @@ void test_safe_swap_scope() {
 	objm1.printinfo();
 	objm2.printinfo();
 }
-//对于现实开发中，我们很难保证嵌套加锁，所以尽可能将互斥操作封装为原子操作，尽量不要在一个函数里嵌套用两个锁。
-//对于嵌套用锁，也可以采用权重的方式限制使用顺序。
-
-// 层级锁
-class hierarchical_mutex {
+//旧版设计：只有拷贝赋值没有移动赋值，swap 实际上做了一次移动构造和两次深拷贝
+class legacy_big_object {
 public:
-	explicit hierarchical_mutex(unsigned long value) : _hierarchy_value(value), _previous_hierarchy_value(0) {}
-	hierarchical_mutex(const hierarchical_mutex&) = delete;
-	hierarchical_mutex& operator=(const hierarchical_mutex&) = delete;
-
-	void lock() {
-		check_for_hierarchy_violation();
-		_internal_mutex.lock();
-		update_hierarchy_value();
-	}
-
-	void unlock() {
-		if (_this_thread_hierarchy_value != _hierarchy_value) {
-			throw std::logic_error("mutex hierarchy violated");
+	legacy_big_object(int data, std::size_t payload_size) :_data(data), _payload(payload_size) {}
+	legacy_big_object(const legacy_big_object& b2) = default;
+	legacy_big_object(legacy_big_object&& b2) :_data(b2._data), _payload(std::move(b2._payload)) {}
+	legacy_big_object& operator = (const legacy_big_object& b2) {
+		if (this == &b2) {
+			return *this;
 		}
-		_this_thread_hierarchy_value = _previous_hierarchy_value;
-		_internal_mutex.unlock();
+		_data = b2._data;
+		_payload = b2._payload;
+		return *this;
+	}
+	friend void swap(legacy_big_object& b1, legacy_big_object& b2) {
+		legacy_big_object temp = std::move(b1);
+		b1 = std::move(b2);
+		b2 = std::move(temp);
 	}
+private:
+	int _data;
+	std::vector<char> _payload;
+};
 
-	bool try_lock() {
-		check_for_hierarchy_violation();
-		if (!_internal_mutex.try_lock()) {  // 修正条件判断
-			return false;
-		}
-		update_hierarchy_value();
-		return true;
+//反复调用真正的交换函数（lock_swap 或 scoped_swap），返回平均每次的耗时（纳秒）。
+//单线程没有竞争，加锁和解锁是不随负载变化的常数，耗时随负载的变化全部来自临界区；
+//加上 --trace 运行时，big_object_mgr 锁的 "lock hold" 区间就是这里的临界区
+template<typename Obj>
+double measure_swap_hold(basic_object_mgr<Obj>& a, basic_object_mgr<Obj>& b, int rounds,
+	void (*swap_fn)(basic_object_mgr<Obj>&, basic_object_mgr<Obj>&)) {
+	auto start = std::chrono::steady_clock::now();
+	for (int i = 0; i < rounds; ++i) {
+		swap_fn(a, b);
 	}
+	auto total = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+	return static_cast<double>(total.count()) / rounds;
+}
 
-private:
-	std::mutex _internal_mutex;
-	unsigned long const _hierarchy_value;
-	unsigned long _previous_hierarchy_value;
-	static thread_local unsigned long _this_thread_hierarchy_value;
-
-	void check_for_hierarchy_violation() {
-		if (_this_thread_hierarchy_value <= _hierarchy_value) {
-			throw std::logic_error("mutex hierarchy violated");
+double elapsed_ns(std::chrono::steady_clock::time_point start) {
+	return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now() - start).count());
+}
+
+void bench_big_object_swap() {
+	std::size_t const sizes[] = { 8, 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024, 100 * 1024 * 1024 };
+	for (std::size_t size : sizes) {
+		//大负载时减少轮数，避免旧版深拷贝耗时过长
+		int const rounds = size >= 16 * 1024 * 1024 ? 5 : 200;
+		basic_object_mgr<legacy_big_object> l1(5, size);
+		basic_object_mgr<legacy_big_object> l2(100, size);
+		double legacy_lock_ns = measure_swap_hold(l1, l2, rounds, lock_swap<legacy_big_object>);
+		double legacy_scoped_ns = measure_swap_hold(l1, l2, rounds, scoped_swap<legacy_big_object>);
+
+		big_object_mgr o1(5, size);
+		big_object_mgr o2(100, size);
+		double pimpl_lock_ns = measure_swap_hold(o1, o2, rounds, lock_swap<som_big_object>);
+		double pimpl_scoped_ns = measure_swap_hold(o1, o2, rounds, scoped_swap<som_big_object>);
+
+		//替换对象分两段计时：replace 在锁内只交换指针，旧负载随返回值在锁释放后析构
+		big_object_mgr mgr(0, size);
+		som_big_object fresh(1, size);
+		auto start = std::chrono::steady_clock::now();
+		som_big_object old = mgr.replace(std::move(fresh));
+		double replace_ns = elapsed_ns(start);
+		start = std::chrono::steady_clock::now();
+		{
+			som_big_object doomed(std::move(old));
 		}
+		double free_ns = elapsed_ns(start);
+
+		std::cout << "payload " << size << " B: legacy lock_swap " << legacy_lock_ns
+			<< " ns, legacy scoped_swap " << legacy_scoped_ns
+			<< " ns, pimpl lock_swap " << pimpl_lock_ns
+			<< " ns, pimpl scoped_swap " << pimpl_scoped_ns
+			<< " ns, mgr replace under lock " << replace_ns
+			<< " ns, old payload freed after unlock " << free_ns << " ns" << std::endl;
 	}
+}
 
-	void update_hierarchy_value() {
-		_previous_hierarchy_value = _this_thread_hierarchy_value;
-		_this_thread_hierarchy_value = _hierarchy_value;
-	}
-};
+//对于现实开发中，我们很难保证嵌套加锁，所以尽可能将互斥操作封装为原子操作，尽量不要在一个函数里嵌套用两个锁。
+//对于嵌套用锁，也可以采用权重的方式限制使用顺序。
 
-thread_local unsigned long hierarchical_mutex::_this_thread_hierarchy_value(ULONG_MAX);
 
 void test_hierarchy_lock() {
 	hierarchical_mutex hmtx1(1000);
@@ -478,28 +479,58 @@ void test_hierarchy_lock() {
 
 
 
-int main()
-{
-	//use_lock();
-
-	//test_threadsafe_stack1();
-
-	//test_lock();
-
-	//test_dead_lock();
-
-	//test_safe_lock();
-    
-	//test_danger_swap();
-	
-	//test_safe_swap();
-
-	//test_safe_swap_scope();
+//可以通过命令行参数选择要运行的示例，例如 day02-mutexlock test_safe_swap，不带参数时运行 test_hierarchy_lock
+//加上 --trace=PATH 时把加锁的等待和持有区间写到 PATH（Chrome trace JSON），每秒重写一次，死锁演示中途结束也能查看
+struct demo_entry {
+	const char* name;
+	void (*fn)();
+};
 
-	test_hierarchy_lock();
+int main(int argc, char* argv[])
+{
+	demo_entry const demos[] = {
+		{ "use_lock", use_lock },
+		{ "test_threadsafe_stack1", test_threadsafe_stack1 },
+		{ "test_lock", test_lock },
+		{ "test_dead_lock", test_dead_lock },
+		{ "test_safe_lock", test_safe_lock },
+		{ "test_danger_swap", test_danger_swap },
+		{ "test_safe_swap", test_safe_swap },
+		{ "test_safe_swap_scope", test_safe_swap_scope },
+		{ "test_hierarchy_lock", test_hierarchy_lock },
+		{ "bench_big_object_swap", bench_big_object_swap },
+		{ "bench_stack_snapshot", bench_stack_snapshot },
+		{ "stress_snapshot_stack", stress_snapshot_stack },
+	};
+	const char* which = "test_hierarchy_lock";
+	std::string trace_path;
+	for (int i = 1; i < argc; ++i) {
+		if (std::strncmp(argv[i], "--trace=", 8) == 0) {
+			trace_path = argv[i] + 8;
+		}
+		else {
+			which = argv[i];
+		}
+	}
+	bool found = false;
+	for (const auto& demo : demos) {
+		if (std::strcmp(demo.name, which) == 0) {
+			trace::session session(trace_path, std::chrono::seconds(1));
+			demo.fn();
+			found = true;
+		}
+	}
+	if (!found) {
+		std::cerr << "unknown demo " << which << ", available:" << std::endl;
+		for (const auto& demo : demos) {
+			std::cerr << "  " << demo.name << std::endl;
+		}
+		return 1;
+	}
 
 	std::cout << "Hello World!\n";
+#ifdef _WIN32
 	system("pause");
+#endif
+	return 0;
 }
-
-
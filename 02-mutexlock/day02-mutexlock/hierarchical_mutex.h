@@ -0,0 +1,74 @@
+﻿// hierarchical_mutex.h
+#pragma once
+
+#include <climits>
+#include <mutex>
+#include <stdexcept>
+#include "../../common/trace.h"
+
+// 层级锁
+// 开启追踪时记录等待和持有区间，参数为层级值
+class hierarchical_mutex {
+public:
+	explicit hierarchical_mutex(unsigned long value) : _hierarchy_value(value), _previous_hierarchy_value(0) {}
+	hierarchical_mutex(const hierarchical_mutex&) = delete;
+	hierarchical_mutex& operator=(const hierarchical_mutex&) = delete;
+
+	void lock() {
+		check_for_hierarchy_violation();
+		std::uint64_t const begin = trace::now();
+		if (begin == 0) {
+			_internal_mutex.lock();
+		}
+		else if (_internal_mutex.try_lock()) {
+			_hold_begin = begin;
+		}
+		else {
+			//没有立即拿到锁时才记录等待区间
+			_internal_mutex.lock();
+			_hold_begin = trace::now();
+			trace::complete("lock wait", "hierarchical_mutex", begin, _hold_begin, _hierarchy_value);
+		}
+		update_hierarchy_value();
+	}
+
+	void unlock() {
+		if (_this_thread_hierarchy_value != _hierarchy_value) {
+			throw std::logic_error("mutex hierarchy violated");
+		}
+		_this_thread_hierarchy_value = _previous_hierarchy_value;
+		std::uint64_t const begin = _hold_begin;
+		_hold_begin = 0;
+		trace::complete("lock hold", "hierarchical_mutex", begin, _hierarchy_value);
+		_internal_mutex.unlock();
+	}
+
+	bool try_lock() {
+		check_for_hierarchy_violation();
+		if (!_internal_mutex.try_lock()) {  // 修正条件判断
+			return false;
+		}
+		_hold_begin = trace::now();
+		update_hierarchy_value();
+		return true;
+	}
+
+private:
+	std::mutex _internal_mutex;
+	unsigned long const _hierarchy_value;
+	unsigned long _previous_hierarchy_value;
+	std::uint64_t _hold_begin = 0;  // 持有开始的时刻，只有持有者读写
+	//每个线程当前持有的最低层级，初始为最大值表示还没有持有任何层级锁
+	static inline thread_local unsigned long _this_thread_hierarchy_value = ULONG_MAX;
+
+	void check_for_hierarchy_violation() {
+		if (_this_thread_hierarchy_value <= _hierarchy_value) {
+			throw std::logic_error("mutex hierarchy violated");
+		}
+	}
+
+	void update_hierarchy_value() {
+		_previous_hierarchy_value = _this_thread_hierarchy_value;
+		_this_thread_hierarchy_value = _hierarchy_value;
+	}
+};
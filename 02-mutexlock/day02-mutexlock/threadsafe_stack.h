@@ -0,0 +1,256 @@
+﻿// threadsafe_stack.h
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <stack>
+#include <vector>
+#include "../../common/eventcount.h"
+
+// 线程不安全的栈类模板
+template<typename T>
+class threadsafe_stack1
+{
+private:
+	std::stack<T> data;// 数据栈
+	mutable std::mutex m; // 保护数据栈的互斥锁
+public:
+	threadsafe_stack1() {} // 默认构造函数
+
+	// 拷贝构造函数，确保线程安全
+	threadsafe_stack1(const threadsafe_stack1& other)
+	{
+		// 互斥锁保护
+		std::lock_guard<std::mutex> lock(other.m);
+		//①在构造函数的函数体（constructor body）内进行复制操作
+		data = other.data;
+	}
+	// 禁止赋值操作
+	threadsafe_stack1& operator=(const threadsafe_stack1&) = delete;
+	// 添加元素
+	void push(T new_value)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		data.push(std::move(new_value));
+	}
+
+	// 弹出元素（问题：返回拷贝的栈顶元素）
+	T pop()
+	{
+		std::lock_guard<std::mutex> lock(m);
+		auto element = data.top();
+		data.pop();
+		return element;
+	}
+	// 检查栈是否为空
+	bool empty() const
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return data.empty();
+	}
+};
+
+// 自定义异常类，用于空栈的异常处理
+struct empty_stack : std::exception
+{
+	const char* what() const throw()
+	{
+		return "Stack is empty";
+	}
+};
+
+// 改进的线程安全栈，提供异常安全的 pop 方法
+template<typename T>
+class threadsafe_stack
+{
+private:
+	std::stack<T> data;
+	mutable std::mutex m;
+	eventcount ec; // 空栈时阻塞消费者
+public:
+	threadsafe_stack() {}
+	threadsafe_stack(const threadsafe_stack& other)
+	{
+		std::lock_guard<std::mutex> lock(other.m);
+		//①在构造函数的函数体（constructor body）内进行复制操作
+		data = other.data;   
+	}
+	threadsafe_stack& operator=(const threadsafe_stack&) = delete;
+	void push(T new_value)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m);
+			data.push(std::move(new_value));
+		}
+		//没有消费者在等待时不会进入内核
+		ec.notify_one();
+	}
+	// 弹出元素并返回 shared_ptr 指针，这里不一样
+	std::shared_ptr<T> pop()
+	{
+		std::lock_guard<std::mutex> lock(m);
+		//②试图弹出前检查是否为空栈
+		if (data.empty()) throw empty_stack();
+		//③改动栈容器前设置返回值
+			std::shared_ptr<T> const res(std::make_shared<T>(data.top()));    
+			data.pop();
+		return res;
+	}
+	// 弹出元素并存储在传入的引用中
+	void pop(T& value)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		if (data.empty()) throw empty_stack();
+		value = data.top();
+		data.pop();
+	}
+	// 非阻塞弹出，空栈时返回 false 而不是抛异常
+	bool try_pop(T& value)
+	{
+		std::lock_guard<std::mutex> lock(m);
+		if (data.empty()) return false;
+		value = std::move(data.top());
+		data.pop();
+		return true;
+	}
+	// 阻塞弹出，空栈时通过 eventcount 睡眠等待 push
+	void wait_and_pop(T& value)
+	{
+		while (!try_pop(value)) {
+			eventcount::key_type key = ec.prepare_wait();
+			//登记为等待者之后再检查一次，避免丢失唤醒
+			if (try_pop(value)) {
+				ec.cancel_wait();
+				return;
+			}
+			ec.commit_wait(key);
+		}
+	}
+	bool empty() const
+	{
+		std::lock_guard<std::mutex> lock(m);
+		return data.empty();
+	}
+};
+// 不可变（持久化）栈：节点一旦创建就不再修改，多个版本共享同一条尾链，
+// 拷贝只是增加一个引用计数，所以拷贝和快照都是 O(1)
+template<typename T>
+class persistent_stack
+{
+private:
+	struct node
+	{
+		node(T v, std::shared_ptr<node> n) :value(std::move(v)), next(std::move(n)), size(next ? next->size + 1 : 1) {}
+		// 长链表逐个释放，避免递归析构导致栈溢出：嵌套的析构只把后继交给本线程的待释放列表，
+		// 由最外层的析构循环释放。是否真正释放由 shared_ptr 自己的引用计数决定，
+		// 不根据 use_count() 猜测独占（它是 relaxed 读，和其他线程对节点的读取之间没有同步）
+		~node()
+		{
+			if (!next) return;
+			static thread_local std::vector<std::shared_ptr<node>> pending;
+			static thread_local bool releasing = false;
+			pending.push_back(std::move(next));
+			if (releasing) return;
+			releasing = true;
+			while (!pending.empty()) {
+				std::shared_ptr<node> n = std::move(pending.back());
+				pending.pop_back();
+			}
+			releasing = false;
+		}
+		T const value;
+		std::shared_ptr<node> next;
+		std::size_t size;         // 发布之后不再修改；snapshot_stack::push 在 CAS 重试时随 next 更新
+	};
+	std::shared_ptr<node> head;
+
+	explicit persistent_stack(std::shared_ptr<node> h) :head(std::move(h)) {}
+
+	template<typename U>
+	friend class snapshot_stack;
+public:
+	persistent_stack() {}
+
+	bool empty() const { return !head; }
+	std::size_t size() const { return head ? head->size : 0; }
+
+	const T& top() const
+	{
+		if (!head) throw empty_stack();
+		return head->value;
+	}
+	// 返回压入新元素后的新版本，原版本不受影响
+	persistent_stack push(T new_value) const
+	{
+		return persistent_stack(std::make_shared<node>(std::move(new_value), head));
+	}
+	persistent_stack pop() const
+	{
+		if (!head) throw empty_stack();
+		return persistent_stack(head->next);
+	}
+	// 从栈顶到栈底依次访问
+	template<typename Fn>
+	void for_each(Fn&& fn) const
+	{
+		for (const node* n = head.get(); n != nullptr; n = n->next.get()) {
+			fn(n->value);
+		}
+	}
+};
+
+// 支持 O(1) 快照的并发栈：栈顶是一个原子 shared_ptr，写者通过 CAS 发布新的栈顶，
+// snapshot() 只是原子地拷贝一次栈顶指针，不会像 threadsafe_stack 的拷贝构造那样锁住整个栈做深拷贝
+template<typename T>
+class snapshot_stack
+{
+private:
+	using node = typename persistent_stack<T>::node;
+	std::shared_ptr<node> head;
+public:
+	snapshot_stack() {}
+	snapshot_stack(const snapshot_stack&) = delete;
+	snapshot_stack& operator=(const snapshot_stack&) = delete;
+
+	void push(T new_value)
+	{
+		auto new_node = std::make_shared<node>(std::move(new_value), std::atomic_load(&head));
+		//CAS 失败时 new_node->next 已被换成最新栈顶，节点还没有发布，可以同步更新 size 后重试
+		while (!std::atomic_compare_exchange_weak(&head, &new_node->next, new_node)) {
+			new_node->size = new_node->next ? new_node->next->size + 1 : 1;
+		}
+	}
+
+	// 与 threadsafe_stack 一样，空栈时抛出 empty_stack
+	void pop(T& value)
+	{
+		std::shared_ptr<node> old_head = std::atomic_load(&head);
+		do {
+			if (!old_head) throw empty_stack();
+		} while (!std::atomic_compare_exchange_weak(&head, &old_head, old_head->next));
+		value = old_head->value;
+	}
+
+	bool try_pop(T& value)
+	{
+		std::shared_ptr<node> old_head = std::atomic_load(&head);
+		do {
+			if (!old_head) return false;
+		} while (!std::atomic_compare_exchange_weak(&head, &old_head, old_head->next));
+		value = old_head->value;
+		return true;
+	}
+
+	bool empty() const
+	{
+		return !std::atomic_load(&head);
+	}
+
+	// O(1) 快照，得到的是某一时刻栈的不可变版本，之后的写入不影响它
+	persistent_stack<T> snapshot() const
+	{
+		return persistent_stack<T>(std::atomic_load(&head));
+	}
+};
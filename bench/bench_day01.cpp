@@ -0,0 +1,111 @@
+// bench_day01.cpp
+// 01-thread 项目：parallel_accumulate、joining_thread 启动、thread_pool 提交
+#include "bench_util.h"
+#include "joining_thread.h"
+#include "parallel_accumulate.h"
+#include "thread_pool.h"
+#include "trace.h"
+#include <atomic>
+#include <memory>
+#include <numeric>
+
+namespace bench {
+
+namespace {
+
+// parallel_accumulate 的 results 数组如果在循环里逐个元素地更新，相邻线程的结果落在同一条
+// cache line 上；Slot 决定每个线程的结果是紧挨着放还是各占一条 cache line
+template<typename Slot>
+void accumulate_into_results(state& st, const std::vector<long long>& vec) {
+    unsigned const n = st.threads();
+    std::vector<Slot> results(n);
+    run_threads(st, n, [&](unsigned i) {
+        std::size_t const block = vec.size() / n;
+        std::size_t const first = block * i;
+        std::size_t const last = i + 1 == n ? vec.size() : first + block;
+        std::atomic<long long>& sum = results[i].value;
+        for (std::size_t k = first; k < last; ++k) {
+            sum.store(sum.load(std::memory_order_relaxed) + vec[k], std::memory_order_relaxed);
+        }
+        });
+    long long total = 0;
+    for (const auto& r : results) {
+        total += r.value.load();
+    }
+    if (total != static_cast<long long>(vec.size()) * (static_cast<long long>(vec.size()) - 1) / 2) {
+        throw std::logic_error("accumulate_block_results returned a wrong sum");
+    }
+}
+
+struct plain_slot {
+    std::atomic<long long> value{ 0 };
+};
+
+}
+
+void register_day01(registry& reg) {
+    reg.add("parallel_accumulate", default_thread_sweep(), { 10000, 1000000, 10000000 }, [](state& st) {
+        std::vector<long long> vec(st.size());
+        std::iota(vec.begin(), vec.end(), 0LL);
+        st.start();
+        long long sum = parallel_accumulate(vec.begin(), vec.end(), 0LL, st.threads());
+        st.stop();
+        if (sum != static_cast<long long>(st.size()) * (static_cast<long long>(st.size()) - 1) / 2) {
+            throw std::logic_error("parallel_accumulate returned a wrong sum");
+        }
+        st.set_ops(st.size());
+        });
+
+    reg.add_layout("accumulate_block_results", default_thread_sweep(), { 10000000 }, [](state& st) {
+        std::vector<long long> vec(st.size());
+        std::iota(vec.begin(), vec.end(), 0LL);
+        if (st.padded()) {
+            accumulate_into_results<padded_slot<std::atomic<long long>>>(st, vec);
+        }
+        else {
+            accumulate_into_results<plain_slot>(st, vec);
+        }
+        st.set_ops(st.size());
+        });
+
+    // threads 个线程并发地反复启动并 join 一个 joining_thread
+    reg.add("joining_thread_launch", default_thread_sweep(), { 2000 }, [](state& st) {
+        run_threads(st, st.threads(), [&st](unsigned i) {
+            std::size_t n = share_of(st.size(), st.threads(), i);
+            for (std::size_t k = 0; k < n; ++k) {
+                joining_thread t([](std::size_t v) { volatile std::size_t sink = v; (void)sink; }, k);
+            }
+            });
+        st.set_ops(st.size());
+        });
+
+    // 开启追踪时一个 scope span 的开销（两次取时间戳加一次追加），每个线程写自己的缓冲区。
+    // 每次结束都清空，块回到空闲池，之后的重复不再分配内存；预热那一次把池子填满
+    reg.add_trace("trace_scope_event", default_thread_sweep(), { 1000000 }, [](state& st) {
+        trace::enable();
+        run_threads(st, st.threads(), [&st](unsigned i) {
+            std::size_t n = share_of(st.size(), st.threads(), i);
+            for (std::size_t k = 0; k < n; ++k) {
+                trace::scope span("event", "bench", k);
+            }
+            });
+        trace::disable();
+        trace::clear();
+        st.set_ops(st.size());
+        });
+
+    // 提交 size 个任务并等待线程池执行完毕，threads 为工作线程数
+    reg.add("thread_pool_submit", default_thread_sweep(), { 100000 }, [](state& st) {
+        std::atomic<std::size_t> done(0);
+        auto pool = std::make_unique<thread_pool>(st.threads(), 4096);
+        st.start();
+        for (std::size_t i = 0; i < st.size(); ++i) {
+            pool->submit([&done]() { done.fetch_add(1, std::memory_order_relaxed); });
+        }
+        pool.reset();
+        st.stop();
+        st.set_ops(st.size());
+        });
+}
+
+}
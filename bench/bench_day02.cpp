@@ -0,0 +1,136 @@
+// bench_day02.cpp
+// 02-mutexlock 项目：线程安全栈、use_lock 计数器、层级锁、两把锁的交换
+#include "bench_util.h"
+#include "big_object.h"
+#include "hierarchical_mutex.h"
+#include "threadsafe_stack.h"
+#include <memory>
+#include <mutex>
+
+namespace bench {
+
+namespace {
+
+// 每个线程先 push 再 pop，任何时刻 push 次数都不少于 pop 次数，栈不会被弹空
+template<typename Stack>
+void stack_push_pop(state& st) {
+    Stack stack;
+    run_threads(st, st.threads(), [&](unsigned i) {
+        std::size_t n = share_of(st.size(), st.threads(), i);
+        int value = 0;
+        for (std::size_t k = 0; k < n; ++k) {
+            stack.push(static_cast<int>(k));
+            stack.pop(value);
+        }
+        });
+    st.set_ops(st.size());
+}
+
+// threadsafe_stack1 的 pop 直接返回元素
+struct stack1_adapter {
+    threadsafe_stack1<int> s;
+    void push(int v) { s.push(v); }
+    void pop(int& v) { v = s.pop(); }
+};
+
+// 每个线程只用自己的那把锁和计数器，彼此之间没有逻辑上的竞争，只可能在 cache line 上冲突
+struct striped_counter {
+    std::mutex mtx;
+    long long count = 0;
+};
+
+template<typename Slot>
+void striped_lock_counters(state& st) {
+    std::vector<Slot> slots(st.threads());
+    run_threads(st, st.threads(), [&](unsigned i) {
+        std::size_t n = share_of(st.size(), st.threads(), i);
+        striped_counter& c = slots[i].value;
+        for (std::size_t k = 0; k < n; ++k) {
+            std::lock_guard<std::mutex> lock(c.mtx);
+            ++c.count;
+        }
+        });
+    st.set_ops(st.size());
+}
+
+struct plain_striped_counter {
+    striped_counter value;
+};
+
+}
+
+void register_day02(registry& reg) {
+    reg.add("threadsafe_stack_push_pop", default_thread_sweep(), { 200000 }, stack_push_pop<threadsafe_stack<int>>);
+    reg.add("threadsafe_stack1_push_pop", default_thread_sweep(), { 200000 }, stack_push_pop<stack1_adapter>);
+    reg.add("snapshot_stack_push_pop", default_thread_sweep(), { 200000 }, stack_push_pop<snapshot_stack<int>>);
+
+    // use_lock 的计数方式：每次加锁后递增共享计数，去掉了演示用的打印和睡眠
+    reg.add("use_lock_counter", default_thread_sweep(), { 1000000 }, [](state& st) {
+        std::mutex mtx;
+        long long shared = 0;
+        run_threads(st, st.threads(), [&](unsigned i) {
+            std::size_t n = share_of(st.size(), st.threads(), i);
+            for (std::size_t k = 0; k < n; ++k) {
+                mtx.lock();
+                ++shared;
+                mtx.unlock();
+            }
+            });
+        if (shared != static_cast<long long>(st.size())) {
+            throw std::logic_error("use_lock counter lost updates");
+        }
+        st.set_ops(st.size());
+        });
+
+    reg.add_layout("striped_lock_counter", default_thread_sweep(), { 1000000 }, [](state& st) {
+        if (st.padded()) {
+            striped_lock_counters<padded_slot<striped_counter>>(st);
+        }
+        else {
+            striped_lock_counters<plain_striped_counter>(st);
+        }
+        });
+
+    // 按层级从高到低嵌套加锁
+    reg.add("hierarchical_mutex_nested", default_thread_sweep(), { 500000 }, [](state& st) {
+        hierarchical_mutex high(1000);
+        hierarchical_mutex low(500);
+        long long shared = 0;
+        run_threads(st, st.threads(), [&](unsigned i) {
+            std::size_t n = share_of(st.size(), st.threads(), i);
+            for (std::size_t k = 0; k < n; ++k) {
+                std::lock_guard<hierarchical_mutex> g1(high);
+                std::lock_guard<hierarchical_mutex> g2(low);
+                ++shared;
+            }
+            });
+        st.set_ops(st.size());
+        });
+
+    // 在 8 个 big_object_mgr 之间随机两两交换，size 为负载字节数
+    auto swap_case = [](void (*swap_fn)(big_object_mgr&, big_object_mgr&)) {
+        return [swap_fn](state& st) {
+            std::size_t const count = 8;
+            std::size_t const swaps = 100000;
+            std::vector<std::unique_ptr<big_object_mgr>> mgrs;
+            for (std::size_t i = 0; i < count; ++i) {
+                mgrs.push_back(std::make_unique<big_object_mgr>(static_cast<int>(i), st.size()));
+            }
+            run_threads(st, st.threads(), [&](unsigned i) {
+                std::size_t n = share_of(swaps, st.threads(), i);
+                unsigned seed = i * 2654435761u + 1;
+                for (std::size_t k = 0; k < n; ++k) {
+                    seed = seed * 1103515245u + 12345u;
+                    std::size_t a = (seed >> 8) % count;
+                    std::size_t b = (seed >> 20) % count;
+                    swap_fn(*mgrs[a], *mgrs[b]);
+                }
+                });
+            st.set_ops(swaps);
+        };
+    };
+    reg.add("safe_swap", default_thread_sweep(), { 8, 1024 * 1024 }, swap_case(lock_swap));
+    reg.add("safe_swap_scope", default_thread_sweep(), { 8, 1024 * 1024 }, swap_case(scoped_swap));
+}
+
+}
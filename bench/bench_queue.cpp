@@ -0,0 +1,85 @@
+// bench_queue.cpp
+// 条件变量队列项目：生产者到消费者的交接
+#include "bench_util.h"
+#include "threadsafe_queue.h"
+#include <cstring>
+#include <memory>
+
+namespace bench {
+
+namespace {
+
+template<typename T>
+void pop_one(threadsafe_queue<T>& q, T& value) { q.wait_and_pop(value); }
+
+template<typename T>
+void pop_one(ec_threadsafe_queue<T>& q, T& value) { q.wait_and_pop(value); }
+
+template<typename T>
+void pop_one(bounded_queue<T>& q, T& value) { q.pop(value); }
+
+// threads 个生产者和 threads 个消费者共用一个队列，总共传递 size 个元素
+template<typename Queue, typename Make>
+void handoff(state& st, Make make_queue) {
+    auto q = make_queue();
+    unsigned const pairs = st.threads();
+    run_threads(st, pairs * 2, [&](unsigned i) {
+        if (i < pairs) {
+            std::size_t n = share_of(st.size(), pairs, i);
+            for (std::size_t k = 0; k < n; ++k) {
+                q->push(static_cast<int>(k));
+            }
+        }
+        else {
+            std::size_t n = share_of(st.size(), pairs, i - pairs);
+            int value = 0;
+            for (std::size_t k = 0; k < n; ++k) {
+                pop_one(*q, value);
+            }
+        }
+        });
+    st.set_ops(st.size());
+}
+
+struct record {
+    unsigned char data[256];
+};
+
+}
+
+void register_queue(registry& reg) {
+    reg.add("queue_handoff_threadsafe_queue", default_thread_sweep(), { 200000 }, [](state& st) {
+        handoff<threadsafe_queue<int>>(st, []() { return std::make_unique<threadsafe_queue<int>>(); });
+        });
+    reg.add("queue_handoff_ec_threadsafe_queue", default_thread_sweep(), { 200000 }, [](state& st) {
+        handoff<ec_threadsafe_queue<int>>(st, []() { return std::make_unique<ec_threadsafe_queue<int>>(); });
+        });
+    reg.add("queue_handoff_bounded_queue", default_thread_sweep(), { 200000 }, [](state& st) {
+        handoff<bounded_queue<int>>(st, []() { return std::make_unique<bounded_queue<int>>(1024); });
+        });
+
+    // 单生产者单消费者，原地填充 / 读取 256 字节的记录；固定两个线程
+    reg.add_fixed_threads("queue_handoff_slot_queue", 2, { 200000 }, [](state& st) {
+        slot_queue<record> q(256);
+        run_threads(st, st.threads(), [&](unsigned i) {
+            if (i == 0) {
+                for (std::size_t k = 0; k < st.size(); ++k) {
+                    record& r = q.reserve();
+                    std::memset(r.data, static_cast<int>(k & 0xff), sizeof(r.data));
+                    q.commit(r);
+                }
+            }
+            else {
+                for (std::size_t k = 0; k < st.size(); ++k) {
+                    const record& r = q.peek();
+                    volatile unsigned char c = r.data[0];
+                    (void)c;
+                    q.release(r);
+                }
+            }
+            });
+        st.set_ops(st.size());
+        });
+}
+
+}
@@ -0,0 +1,52 @@
+// bench_util.h
+#pragma once
+
+#include "harness.h"
+#include <atomic>
+#include <cassert>
+#include <thread>
+#include <vector>
+
+namespace bench {
+
+// 先创建好 n 个线程，全部就绪后再开始计时并放行，避免把线程创建的开销算进去
+template<typename Fn>
+void run_threads(state& st, unsigned n, Fn fn) {
+    std::atomic<unsigned> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    threads.reserve(n);
+    for (unsigned i = 0; i < n; ++i) {
+        threads.emplace_back([&, i]() {
+            thread_counters counters(st);
+            ready.fetch_add(1);
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            counters.start();
+            fn(i);
+            counters.stop();
+        });
+    }
+    while (ready.load() != n) {
+        std::this_thread::yield();
+    }
+    st.start();
+    go.store(true, std::memory_order_release);
+    for (auto& t : threads) t.join();
+    st.stop();
+}
+
+// 每个线程独占一条 cache line 的槽位，用于布局敏感的基准对照
+template<typename T>
+struct alignas(64) padded_slot {
+    T value;
+};
+
+// 把 total 次操作尽量平均地分给 n 个线程，返回第 i 个线程的份额
+inline std::size_t share_of(std::size_t total, unsigned n, unsigned i) {
+    assert(n > 0 && "thread count must be positive");
+    return total / n + (i < total % n ? 1 : 0);
+}
+
+}
@@ -0,0 +1,164 @@
+// harness.h
+#pragma once
+
+#include "perf_counters.h"
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// 一次运行的参数组合
+struct params {
+    unsigned threads;
+    std::size_t size;
+    bool padded = true;     // 对布局敏感的基准：每个线程的数据是否各占一条 cache line
+    bool counting = false;  // 是否在被测区域内打开硬件计数器
+};
+
+// 传给基准函数的状态：函数内部先做准备工作，再用 start()/stop() 圈出被测区域，
+// 最后用 set_ops() 告诉框架这次做了多少次操作。没有调用 start() 时整个函数都计入耗时。
+// 开启计数时 start()/stop() 在调用线程上打开一组计数器，之后由它创建的线程一并统计；
+// 之前就创建好的工作线程用 thread_counters 自己计数，结果汇总到这里
+class state {
+public:
+    explicit state(const params& p) : _params(p) {}
+
+    unsigned threads() const { return _params.threads; }
+    std::size_t size() const { return _params.size; }
+    bool padded() const { return _params.padded; }
+    bool counting() const { return _params.counting; }
+
+    void start() {
+        if (_params.counting) {
+            _group.reset(new perf_group(true));
+            _group->start();
+        }
+        _started = true;
+        _begin = std::chrono::steady_clock::now();
+    }
+
+    void stop() {
+        _end = std::chrono::steady_clock::now();
+        _stopped = true;
+        if (_group) {
+            add_counters(_group->stop());
+            _group.reset();
+        }
+    }
+
+    void add_counters(const perf_totals& totals) {
+        std::lock_guard<std::mutex> lock(_counters_mtx);
+        _counters.add(totals);
+    }
+    const perf_totals& counters() const { return _counters; }
+
+    void set_ops(std::uint64_t ops) { _ops = ops; }
+    std::uint64_t ops() const { return _ops; }
+
+    bool started() const { return _started; }
+    bool stopped() const { return _stopped; }
+    std::chrono::steady_clock::time_point begin_time() const { return _begin; }
+    std::chrono::steady_clock::time_point end_time() const { return _end; }
+
+private:
+    params _params;
+    std::uint64_t _ops = 1;
+    bool _started = false;
+    bool _stopped = false;
+    std::chrono::steady_clock::time_point _begin;
+    std::chrono::steady_clock::time_point _end;
+    std::unique_ptr<perf_group> _group;
+    std::mutex _counters_mtx;
+    perf_totals _counters;
+};
+
+// 工作线程自己的计数器，state 没有开启计数时什么也不做。
+// 在线程就绪前构造（打开计数器的系统调用不计入耗时），围住线程的工作部分调用 start()/stop()
+class thread_counters {
+public:
+    explicit thread_counters(state& st) : _st(st) {
+        if (st.counting()) {
+            _group.reset(new perf_group(true));
+        }
+    }
+    void start() {
+        if (_group) _group->start();
+    }
+    void stop() {
+        if (_group) _st.add_counters(_group->stop());
+    }
+private:
+    state& _st;
+    std::unique_ptr<perf_group> _group;
+};
+
+using bench_fn = std::function<void(state&)>;
+
+// 一个基准：名字、要扫描的线程数和数据规模。layout_sensitive 的基准会读取 state::padded()，
+// 伪共享检测模式下分别用不加填充和加填充的布局各跑一遍。uses_trace 的基准自己开关并清空追踪缓冲区，
+// 和 --trace 同时使用时跳过。fixed_threads 的基准线程数由算法本身决定，不受 --threads 影响
+struct case_def {
+    std::string name;
+    std::vector<unsigned> threads;
+    std::vector<std::size_t> sizes;
+    bench_fn fn;
+    bool layout_sensitive = false;
+    bool uses_trace = false;
+    bool fixed_threads = false;
+};
+
+// 一个参数组合多次重复后的统计结果，跟踪的指标是 ns/op 的中位数
+struct result {
+    std::string name;
+    unsigned threads;
+    std::size_t size;
+    int repetitions;
+    std::uint64_t ops;
+    double median_ns_per_op;
+    double mean_ns_per_op;
+    double min_ns_per_op;
+    double stddev_ns_per_op;
+    bool padded;
+    perf_totals counters;   // 所有正式重复的计数之和，按 ops * repetitions 折算到每次操作
+};
+
+class registry {
+public:
+    void add(std::string name, std::vector<unsigned> threads, std::vector<std::size_t> sizes, bench_fn fn) {
+        _cases.push_back(case_def{ std::move(name), std::move(threads), std::move(sizes), std::move(fn) });
+    }
+    // 注册一个对数据布局敏感的基准
+    void add_layout(std::string name, std::vector<unsigned> threads, std::vector<std::size_t> sizes, bench_fn fn) {
+        add(std::move(name), std::move(threads), std::move(sizes), std::move(fn));
+        _cases.back().layout_sensitive = true;
+    }
+    // 注册一个线程数固定的基准，threads 就是它实际使用的线程数
+    void add_fixed_threads(std::string name, unsigned threads, std::vector<std::size_t> sizes, bench_fn fn) {
+        add(std::move(name), { threads }, std::move(sizes), std::move(fn));
+        _cases.back().fixed_threads = true;
+    }
+    // 注册一个测量追踪本身开销的基准
+    void add_trace(std::string name, std::vector<unsigned> threads, std::vector<std::size_t> sizes, bench_fn fn) {
+        add(std::move(name), std::move(threads), std::move(sizes), std::move(fn));
+        _cases.back().uses_trace = true;
+    }
+    const std::vector<case_def>& cases() const { return _cases; }
+private:
+    std::vector<case_def> _cases;
+};
+
+// 默认的线程数扫描：1、2、4 ... 直到硬件线程数
+std::vector<unsigned> default_thread_sweep();
+
+// 各项目注册自己的基准，定义在 bench_*.cpp 中
+void register_day01(registry& reg);
+void register_day02(registry& reg);
+void register_queue(registry& reg);
+
+}
@@ -0,0 +1,463 @@
+// main.cpp
+// 统一的基准测试入口：扫描线程数和数据规模，预热后重复测量，输出 CSV/JSON，
+// 并可以和保存的基线比较，任何指标退化超过阈值时以非零状态退出。
+// --perf 在被测区域内采集硬件计数器，--false-sharing 对布局敏感的基准比较加填充前后的差别，
+// --trace 把整个运行过程中的线程、加锁和分块事件写成 Chrome trace JSON
+#include "harness.h"
+#include "trace.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <map>
+#include <sstream>
+#include <thread>
+
+namespace bench {
+
+std::vector<unsigned> default_thread_sweep() {
+    unsigned const hw = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> sweep;
+    for (unsigned t = 1; t < hw; t *= 2) {
+        sweep.push_back(t);
+    }
+    sweep.push_back(hw);
+    return sweep;
+}
+
+}
+
+namespace {
+
+struct options {
+    std::string filter;
+    int warmup = 1;
+    int repetitions = 5;
+    std::vector<unsigned> threads;    // 非空时覆盖各基准自己的线程数扫描
+    std::vector<std::size_t> sizes;   // 非空时覆盖各基准自己的规模扫描
+    std::string format = "csv";
+    std::string out;
+    std::string baseline;
+    std::string save_baseline;
+    std::string trace;
+    double threshold = 0.10;
+    bool list = false;
+    bool perf = false;
+    bool false_sharing = false;
+};
+
+void usage() {
+    std::cout <<
+        "usage: bench [options]\n"
+        "  --list                 list registered benchmarks\n"
+        "  --filter=SUBSTR        run only benchmarks whose name contains SUBSTR\n"
+        "  --warmup=N             warmup runs per parameter set (default 1)\n"
+        "  --reps=N               measured repetitions per parameter set (default 5)\n"
+        "  --threads=1,2,4        override the thread-count sweep (fixed-thread benchmarks keep theirs)\n"
+        "  --sizes=1000,100000    override the size sweep\n"
+        "  --format=csv|json      output format (default csv)\n"
+        "  --out=PATH             write results to PATH instead of stdout\n"
+        "  --baseline=PATH        compare against a baseline file, exit 1 on regression\n"
+        "  --threshold=FRACTION   allowed slowdown relative to the baseline (default 0.10)\n"
+        "  --save-baseline=PATH   write the results as a new baseline file\n"
+        "  --perf                 collect hardware counters (perf_event_open) around measured regions\n"
+        "  --false-sharing        run layout-sensitive benchmarks unpadded and padded and report the delta\n"
+        "  --trace=PATH           record a Chrome trace-event timeline of the run to PATH\n";
+}
+
+// 解析一个正整数，不是正整数或超出 T 的范围时返回 false
+template<typename T>
+bool parse_positive(const std::string& text, T& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos) {
+        return false;
+    }
+    unsigned long long v = 0;
+    try {
+        v = std::stoull(text);
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+    if (v == 0 || v > std::numeric_limits<T>::max()) {
+        return false;
+    }
+    value = static_cast<T>(v);
+    return true;
+}
+
+// 解析一个非负的有限浮点数，必须整个字符串都是数字
+bool parse_non_negative(const std::string& text, double& value) {
+    if (text.empty()) {
+        return false;
+    }
+    char* end = nullptr;
+    double v = std::strtod(text.c_str(), &end);
+    if (end != text.c_str() + text.size() || !std::isfinite(v) || v < 0) {
+        return false;
+    }
+    value = v;
+    return true;
+}
+
+// 解析逗号分隔的正整数列表，任何一项不是正整数或超出 T 的范围时返回 false
+template<typename T>
+bool parse_list(const std::string& text, std::vector<T>& values) {
+    values.clear();
+    std::stringstream ss(text);
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        if (item.empty()) {
+            continue;
+        }
+        T v = 0;
+        if (!parse_positive(item, v)) {
+            return false;
+        }
+        values.push_back(v);
+    }
+    return !values.empty();
+}
+
+bool parse_options(int argc, char* argv[], options& opt) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto value = [&arg](const char* prefix) -> const char* {
+            std::size_t n = std::char_traits<char>::length(prefix);
+            return arg.compare(0, n, prefix) == 0 ? arg.c_str() + n : nullptr;
+        };
+        const char* v = nullptr;
+        if (arg == "--list") opt.list = true;
+        else if (arg == "--perf") opt.perf = true;
+        else if (arg == "--false-sharing") opt.false_sharing = true;
+        else if ((v = value("--filter="))) opt.filter = v;
+        else if ((v = value("--warmup="))) opt.warmup = std::atoi(v);
+        else if ((v = value("--reps="))) opt.repetitions = std::max(1, std::atoi(v));
+        else if ((v = value("--threads="))) {
+            if (!parse_list(v, opt.threads)) {
+                std::cerr << "--threads expects a list of positive integers" << std::endl;
+                usage();
+                return false;
+            }
+        }
+        else if ((v = value("--sizes="))) {
+            if (!parse_list(v, opt.sizes)) {
+                std::cerr << "--sizes expects a list of positive integers" << std::endl;
+                usage();
+                return false;
+            }
+        }
+        else if ((v = value("--format="))) opt.format = v;
+        else if ((v = value("--out="))) opt.out = v;
+        else if ((v = value("--baseline="))) opt.baseline = v;
+        else if ((v = value("--threshold="))) {
+            if (!parse_non_negative(v, opt.threshold)) {
+                std::cerr << "--threshold expects a non-negative number" << std::endl;
+                usage();
+                return false;
+            }
+        }
+        else if ((v = value("--save-baseline="))) opt.save_baseline = v;
+        else if ((v = value("--trace="))) opt.trace = v;
+        else {
+            usage();
+            return false;
+        }
+    }
+    if (opt.format != "csv" && opt.format != "json") {
+        std::cerr << "unknown format " << opt.format << std::endl;
+        return false;
+    }
+    return true;
+}
+
+double run_once(const bench::case_def& c, const bench::params& p, std::uint64_t& ops, bench::perf_totals& counters) {
+    bench::state st(p);
+    auto begin = std::chrono::steady_clock::now();
+    c.fn(st);
+    auto end = std::chrono::steady_clock::now();
+    if (st.started()) {
+        begin = st.begin_time();
+        end = st.stopped() ? st.end_time() : end;
+    }
+    ops = std::max<std::uint64_t>(1, st.ops());
+    counters = st.counters();
+    double ns = static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - begin).count());
+    return ns / static_cast<double>(ops);
+}
+
+bench::result measure(const bench::case_def& c, const bench::params& p, const options& opt) {
+    std::uint64_t ops = 0;
+    bench::perf_totals counters;
+    for (int i = 0; i < opt.warmup; ++i) {
+        run_once(c, p, ops, counters);
+    }
+    std::vector<double> samples;
+    bench::perf_totals total;
+    for (int i = 0; i < opt.repetitions; ++i) {
+        samples.push_back(run_once(c, p, ops, counters));
+        total.add(counters);
+    }
+    std::sort(samples.begin(), samples.end());
+    double mean = 0;
+    for (double s : samples) mean += s;
+    mean /= samples.size();
+    double var = 0;
+    for (double s : samples) var += (s - mean) * (s - mean);
+    std::size_t const n = samples.size();
+    double median = n % 2 ? samples[n / 2] : (samples[n / 2 - 1] + samples[n / 2]) / 2;
+    return bench::result{ c.name, p.threads, p.size, opt.repetitions, ops,
+        median, mean, samples.front(), std::sqrt(var / n), p.padded, total };
+}
+
+// 伪共享检测模式下，结果名字带上布局后缀，两种布局在基线里是两项
+std::string name_of(const bench::result& r, const options& opt) {
+    if (!opt.false_sharing) {
+        return r.name;
+    }
+    return r.name + (r.padded ? "[padded]" : "[unpadded]");
+}
+
+// 某个事件折算到每次操作的值，事件不可用时返回负数
+double per_op(const bench::result& r, int id) {
+    if (!r.counters.valid[id]) {
+        return -1;
+    }
+    return static_cast<double>(r.counters.values[id]) / (static_cast<double>(r.ops) * r.repetitions);
+}
+
+double ipc(const bench::result& r) {
+    if (!r.counters.valid[bench::perf_cycles] || !r.counters.valid[bench::perf_instructions]
+        || r.counters.values[bench::perf_cycles] == 0) {
+        return -1;
+    }
+    return static_cast<double>(r.counters.values[bench::perf_instructions]) / r.counters.values[bench::perf_cycles];
+}
+
+std::string key_of(const std::string& name, unsigned threads, std::size_t size) {
+    return name + "/" + std::to_string(threads) + "/" + std::to_string(size);
+}
+
+// 计数器列只在 --perf 时输出，不可用的事件留空
+void write_csv(std::ostream& os, const std::vector<bench::result>& results, const options& opt) {
+    os << "name,threads,size,repetitions,ops,median_ns_per_op,mean_ns_per_op,min_ns_per_op,stddev_ns_per_op";
+    if (opt.perf) {
+        for (int id = 0; id < bench::perf_event_count; ++id) {
+            os << ',' << bench::perf_event_name(id) << "_per_op";
+        }
+        os << ",ipc";
+    }
+    os << '\n';
+    for (const auto& r : results) {
+        os << name_of(r, opt) << ',' << r.threads << ',' << r.size << ',' << r.repetitions << ',' << r.ops << ','
+            << r.median_ns_per_op << ',' << r.mean_ns_per_op << ',' << r.min_ns_per_op << ','
+            << r.stddev_ns_per_op;
+        if (opt.perf) {
+            for (int id = 0; id < bench::perf_event_count; ++id) {
+                os << ',';
+                if (r.counters.valid[id]) os << per_op(r, id);
+            }
+            os << ',';
+            if (ipc(r) >= 0) os << ipc(r);
+        }
+        os << '\n';
+    }
+}
+
+void write_json(std::ostream& os, const std::vector<bench::result>& results, const options& opt) {
+    os << "{\n  \"results\": [\n";
+    for (std::size_t i = 0; i < results.size(); ++i) {
+        const auto& r = results[i];
+        os << "    {\"name\": \"" << name_of(r, opt) << "\", \"threads\": " << r.threads << ", \"size\": " << r.size
+            << ", \"repetitions\": " << r.repetitions << ", \"ops\": " << r.ops
+            << ", \"median_ns_per_op\": " << r.median_ns_per_op << ", \"mean_ns_per_op\": " << r.mean_ns_per_op
+            << ", \"min_ns_per_op\": " << r.min_ns_per_op << ", \"stddev_ns_per_op\": " << r.stddev_ns_per_op;
+        if (opt.perf) {
+            os << ", \"counters\": {";
+            const char* sep = "";
+            for (int id = 0; id < bench::perf_event_count; ++id) {
+                if (r.counters.valid[id]) {
+                    os << sep << "\"" << bench::perf_event_name(id) << "_per_op\": " << per_op(r, id);
+                    sep = ", ";
+                }
+            }
+            if (ipc(r) >= 0) {
+                os << sep << "\"ipc\": " << ipc(r);
+            }
+            os << "}";
+        }
+        os << "}" << (i + 1 < results.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}\n";
+}
+
+// 相邻的两项分别是同一组参数不加填充和加填充的结果
+void report_false_sharing(const std::vector<bench::result>& results) {
+    for (std::size_t i = 0; i + 1 < results.size(); i += 2) {
+        const auto& plain = results[i];
+        const auto& padded = results[i + 1];
+        std::cerr << "false-sharing " << key_of(plain.name, plain.threads, plain.size) << ": unpadded "
+            << plain.median_ns_per_op << " ns/op, padded " << padded.median_ns_per_op << " ns/op";
+        if (padded.median_ns_per_op > 0) {
+            std::cerr << " (" << plain.median_ns_per_op / padded.median_ns_per_op << "x)";
+        }
+        for (int id : { bench::perf_l1d_misses, bench::perf_llc_misses }) {
+            if (plain.counters.valid[id] && padded.counters.valid[id]) {
+                std::cerr << ", " << bench::perf_event_name(id) << "/op " << per_op(plain, id)
+                    << " -> " << per_op(padded, id);
+            }
+        }
+        std::cerr << std::endl;
+    }
+}
+
+// 基线文件每行：name,threads,size,median_ns_per_op，# 开头为注释。
+// 读不到文件或有格式不对的行（例如文件被截断）时打印原因并返回 false
+bool load_baseline(const std::string& path, std::map<std::string, double>& baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        std::cerr << "cannot read baseline " << path << std::endl;
+        return false;
+    }
+    std::string line;
+    for (int number = 1; std::getline(in, line); ++number) {
+        if (line.empty() || line[0] == '#') continue;
+        std::stringstream ss(line);
+        std::string name, threads, size, value, extra;
+        unsigned t = 0;
+        std::size_t n = 0;
+        double ns = 0;
+        if (!std::getline(ss, name, ',') || name.empty() || !std::getline(ss, threads, ',')
+            || !std::getline(ss, size, ',') || !std::getline(ss, value, ',') || std::getline(ss, extra)
+            || !parse_positive(threads, t) || !parse_positive(size, n) || !parse_non_negative(value, ns)) {
+            std::cerr << "malformed baseline line " << path << ":" << number << ": " << line << std::endl;
+            return false;
+        }
+        baseline[key_of(name, t, n)] = ns;
+    }
+    return true;
+}
+
+void save_baseline(const std::string& path, const std::vector<bench::result>& results, const options& opt) {
+    std::ofstream out(path);
+    out << "# name,threads,size,median_ns_per_op\n";
+    for (const auto& r : results) {
+        out << name_of(r, opt) << ',' << r.threads << ',' << r.size << ',' << r.median_ns_per_op << '\n';
+    }
+}
+
+}
+
+int main(int argc, char* argv[]) {
+    options opt;
+    if (!parse_options(argc, argv, opt)) {
+        return 2;
+    }
+
+    bench::registry reg;
+    bench::register_day01(reg);
+    bench::register_day02(reg);
+    bench::register_queue(reg);
+
+    if (opt.list) {
+        for (const auto& c : reg.cases()) {
+            std::cout << c.name << std::endl;
+        }
+        return 0;
+    }
+
+    // 没有权限（perf_event_paranoid）或者不在 Linux 上时照常测时间，只是不输出计数器
+    bool counting = false;
+    if (opt.perf) {
+        std::string reason;
+        counting = bench::perf_available(reason);
+        if (!counting) {
+            std::cerr << "perf counters unavailable: " << reason << "; continuing without them" << std::endl;
+        }
+    }
+
+    // 先读基线，文件有问题时在跑基准之前就失败
+    std::map<std::string, double> baseline;
+    if (!opt.baseline.empty() && !load_baseline(opt.baseline, baseline)) {
+        return 2;
+    }
+
+    std::vector<bench::result> results;
+    std::unique_ptr<trace::session> tracing(new trace::session(opt.trace));
+    for (const auto& c : reg.cases()) {
+        if (!opt.filter.empty() && c.name.find(opt.filter) == std::string::npos) {
+            continue;
+        }
+        if (opt.false_sharing && !c.layout_sensitive) {
+            continue;
+        }
+        if (!opt.trace.empty() && c.uses_trace) {
+            std::cerr << "skipping " << c.name << ": it clears the trace that --trace is recording" << std::endl;
+            continue;
+        }
+        const auto& threads = opt.threads.empty() || c.fixed_threads ? c.threads : opt.threads;
+        const auto& sizes = opt.sizes.empty() ? c.sizes : opt.sizes;
+        for (unsigned t : threads) {
+            for (std::size_t s : sizes) {
+                for (bool padded : { false, true }) {
+                    if (!opt.false_sharing && !padded) {
+                        continue;
+                    }
+                    bench::result r = measure(c, bench::params{ t, s, padded, counting }, opt);
+                    std::cerr << key_of(name_of(r, opt), r.threads, r.size) << ": " << r.median_ns_per_op << " ns/op";
+                    if (counting && ipc(r) >= 0) {
+                        std::cerr << ", ipc " << ipc(r);
+                    }
+                    std::cerr << std::endl;
+                    results.push_back(r);
+                }
+            }
+        }
+    }
+    tracing.reset();
+    if (counting && std::none_of(results.begin(), results.end(),
+        [](const bench::result& r) { return r.counters.valid[bench::perf_cycles]; })) {
+        std::cerr << "hardware events unavailable (no PMU access, e.g. in a VM); only software events reported" << std::endl;
+    }
+    if (opt.false_sharing) {
+        report_false_sharing(results);
+    }
+
+    std::ofstream file;
+    if (!opt.out.empty()) {
+        file.open(opt.out);
+        if (!file) {
+            std::cerr << "cannot write " << opt.out << std::endl;
+            return 2;
+        }
+    }
+    std::ostream& os = opt.out.empty() ? std::cout : file;
+    if (opt.format == "json") {
+        write_json(os, results, opt);
+    }
+    else {
+        write_csv(os, results, opt);
+    }
+
+    if (!opt.save_baseline.empty()) {
+        save_baseline(opt.save_baseline, results, opt);
+    }
+
+    int status = 0;
+    if (!opt.baseline.empty()) {
+        for (const auto& r : results) {
+            auto it = baseline.find(key_of(name_of(r, opt), r.threads, r.size));
+            if (it == baseline.end() || it->second <= 0) {
+                continue;
+            }
+            double ratio = r.median_ns_per_op / it->second;
+            if (ratio > 1.0 + opt.threshold) {
+                std::cerr << "REGRESSION " << key_of(name_of(r, opt), r.threads, r.size) << ": " << r.median_ns_per_op
+                    << " ns/op vs baseline " << it->second << " ns/op (+" << (ratio - 1.0) * 100 << "%)" << std::endl;
+                status = 1;
+            }
+        }
+    }
+    return status;
+}
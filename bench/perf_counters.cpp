@@ -0,0 +1,163 @@
+// perf_counters.cpp
+#include "perf_counters.h"
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace bench {
+
+const char* perf_event_name(int id) {
+    static const char* const names[perf_event_count] = {
+        "cycles", "instructions", "branch_misses", "l1d_misses", "llc_misses", "context_switches",
+    };
+    return names[id];
+}
+
+#ifdef __linux__
+
+namespace {
+
+struct event_spec {
+    std::uint32_t type;
+    std::uint64_t config;
+};
+
+event_spec spec_of(int id) {
+    switch (id) {
+    case perf_cycles: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES };
+    case perf_instructions: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS };
+    case perf_branch_misses: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES };
+    case perf_l1d_misses:
+        return { PERF_TYPE_HW_CACHE, PERF_COUNT_HW_CACHE_L1D
+            | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16) };
+    case perf_llc_misses: return { PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES };
+    default: return { PERF_TYPE_SOFTWARE, PERF_COUNT_SW_CONTEXT_SWITCHES };
+    }
+}
+
+int open_event(int id, int group_fd, bool inherit) {
+    event_spec spec = spec_of(id);
+    perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = spec.type;
+    attr.config = spec.config;
+    attr.disabled = group_fd == -1 ? 1 : 0;
+    attr.inherit = inherit ? 1 : 0;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    long fd = syscall(SYS_perf_event_open, &attr, 0, -1, group_fd, 0);
+    return static_cast<int>(fd);
+}
+
+}
+
+perf_group::perf_group(bool inherit) {
+    _fds.fill(-1);
+    for (int id = 0; id < perf_event_count; ++id) {
+        bool const software = id == perf_context_switches;
+        int group = software ? -1 : _leader;
+        int fd = open_event(id, group, inherit);
+        if (fd < 0 && group != -1) {
+            // 有的 PMU 不允许某个事件进入同一组，退而单独打开
+            fd = open_event(id, -1, inherit);
+        }
+        _fds[id] = fd;
+        if (fd >= 0 && !software && _leader == -1) {
+            _leader = fd;
+        }
+    }
+}
+
+perf_group::~perf_group() {
+    for (int fd : _fds) {
+        if (fd >= 0) {
+            ::close(fd);
+        }
+    }
+}
+
+void perf_group::start() {
+    for (int fd : _fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        }
+    }
+    for (int fd : _fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+}
+
+perf_totals perf_group::stop() {
+    for (int fd : _fds) {
+        if (fd >= 0) {
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        }
+    }
+    perf_totals totals;
+    for (int id = 0; id < perf_event_count; ++id) {
+        if (_fds[id] < 0) {
+            continue;
+        }
+        std::uint64_t buf[3] = { 0, 0, 0 };  // value, time_enabled, time_running
+        if (::read(_fds[id], buf, sizeof(buf)) != static_cast<ssize_t>(sizeof(buf))) {
+            continue;
+        }
+        std::uint64_t value = buf[0];
+        if (buf[2] != 0 && buf[2] < buf[1]) {
+            value = static_cast<std::uint64_t>(static_cast<double>(value) * buf[1] / buf[2]);
+        }
+        totals.values[id] = value;
+        totals.valid[id] = true;
+    }
+    return totals;
+}
+
+bool perf_available(std::string& reason) {
+    int fd = open_event(perf_context_switches, -1, false);
+    if (fd >= 0) {
+        ::close(fd);
+        return true;
+    }
+    int const err = errno;
+    reason = std::strerror(err);
+    std::ifstream paranoid("/proc/sys/kernel/perf_event_paranoid");
+    int level = 0;
+    if (paranoid >> level) {
+        reason += " (perf_event_paranoid = " + std::to_string(level) + ")";
+    }
+    return false;
+}
+
+#else
+
+perf_group::perf_group(bool) {
+    _fds.fill(-1);
+}
+
+perf_group::~perf_group() {}
+
+void perf_group::start() {}
+
+perf_totals perf_group::stop() {
+    return perf_totals();
+}
+
+bool perf_available(std::string& reason) {
+    reason = "perf_event_open is only available on Linux";
+    return false;
+}
+
+#endif
+
+}
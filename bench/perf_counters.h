@@ -0,0 +1,60 @@
+// perf_counters.h
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+namespace bench {
+
+// 采集的硬件/软件事件。cache-line 在核间的转移（HITM）需要各型号 CPU 专用的原始事件，
+// 这里用 LLC miss 近似
+enum perf_event_id {
+    perf_cycles,
+    perf_instructions,
+    perf_branch_misses,
+    perf_l1d_misses,
+    perf_llc_misses,
+    perf_context_switches,
+    perf_event_count,
+};
+
+const char* perf_event_name(int id);
+
+// 多个线程、多次计数的累加结果；某个事件打不开时对应 valid 为 false
+struct perf_totals {
+    std::array<std::uint64_t, perf_event_count> values{};
+    std::array<bool, perf_event_count> valid{};
+
+    void add(const perf_totals& other) {
+        for (int i = 0; i < perf_event_count; ++i) {
+            if (other.valid[i]) {
+                values[i] += other.values[i];
+                valid[i] = true;
+            }
+        }
+    }
+};
+
+// 一个线程上的一组计数器：硬件事件放在同一个 group 里保证同时调度，
+// 上下文切换是软件事件，单独打开。inherit 为 true 时同时统计之后创建的子线程
+class perf_group {
+public:
+    explicit perf_group(bool inherit);
+    ~perf_group();
+    perf_group(const perf_group&) = delete;
+    perf_group& operator=(const perf_group&) = delete;
+
+    void start();
+    // 停止计数并读出结果，被复用（multiplex）时按启用时间比例换算
+    perf_totals stop();
+
+private:
+    std::array<int, perf_event_count> _fds;
+    int _leader = -1;
+};
+
+// 检查当前进程能否使用 perf_event_open；不能时 reason 说明原因（例如 perf_event_paranoid 限制）
+bool perf_available(std::string& reason);
+
+}
@@ -0,0 +1,122 @@
+﻿// eventcount.h
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <climits>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif defined(_WIN32)
+// 不让 windows.h 定义 min/max 宏，否则包含本头文件的代码里 std::min/std::max 无法编译
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#pragma comment(lib, "Synchronization.lib")
+#endif
+
+// 事件计数器（eventcount）：把“检查条件”和“睡眠”拆成两步，让任何无锁或加锁容器都能阻塞消费者，
+// 不会丢失唤醒，也不会像 notify_all 那样惊群。
+// 消费者：
+//   if (try_pop(v)) return;
+//   auto key = ec.prepare_wait();
+//   if (try_pop(v)) { ec.cancel_wait(); return; }
+//   ec.commit_wait(key);   // 然后重新尝试
+// 生产者：修改容器后调用 notify_one()/notify_all()，没有等待者时只是一次原子读，不进内核。
+class eventcount {
+public:
+    using key_type = std::uint32_t;
+
+    eventcount() : _epoch(0), _waiters(0) {}
+    eventcount(const eventcount&) = delete;
+    eventcount& operator=(const eventcount&) = delete;
+
+    // 登记为等待者并返回当前纪元，此后再检查一次条件
+    key_type prepare_wait() {
+        _waiters.fetch_add(1, std::memory_order_seq_cst);
+        return _epoch.load(std::memory_order_seq_cst);
+    }
+
+    // 第二次检查发现条件已满足，取消等待
+    void cancel_wait() {
+        _waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    // 纪元没有变化时睡眠；prepare_wait 之后发生的 notify 都会改变纪元，所以不会丢失唤醒
+    void commit_wait(key_type key) {
+        while (_epoch.load(std::memory_order_acquire) == key) {
+            futex_wait(key);
+            _stat_wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+        _waiters.fetch_sub(1, std::memory_order_seq_cst);
+    }
+
+    void notify_one() {
+        notify(false);
+    }
+
+    void notify_all() {
+        notify(true);
+    }
+
+    // 统计数据，供基准测试读取
+    std::uint64_t wait_syscalls() const { return _stat_wait_syscalls.load(std::memory_order_relaxed); }
+    std::uint64_t wake_syscalls() const { return _stat_wake_syscalls.load(std::memory_order_relaxed); }
+    std::uint64_t wakeups() const { return _stat_wakeups.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<key_type> _epoch;
+    std::atomic<std::uint32_t> _waiters;
+    // 只在已经要进入内核的路径上累加，不影响不睡眠的快速路径
+    std::atomic<std::uint64_t> _stat_wait_syscalls{ 0 };
+    std::atomic<std::uint64_t> _stat_wake_syscalls{ 0 };
+    std::atomic<std::uint64_t> _stat_wakeups{ 0 };
+
+    void notify(bool all) {
+        // 与 prepare_wait 中的 seq_cst 操作配对：要么这里看到等待者，要么等待者看到新数据
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (_waiters.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        _epoch.fetch_add(1, std::memory_order_seq_cst);
+        futex_wake(all);
+    }
+
+    void futex_wait(key_type key) {
+        _stat_wait_syscalls.fetch_add(1, std::memory_order_relaxed);
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&_epoch), FUTEX_WAIT_PRIVATE, key, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+        WaitOnAddress(&_epoch, &key, sizeof(key), INFINITE);
+#else
+        _epoch.wait(key, std::memory_order_acquire);
+#endif
+    }
+
+    void futex_wake(bool all) {
+        _stat_wake_syscalls.fetch_add(1, std::memory_order_relaxed);
+#if defined(__linux__)
+        syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(&_epoch), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+#elif defined(_WIN32)
+        if (all) {
+            WakeByAddressAll(&_epoch);
+        }
+        else {
+            WakeByAddressSingle(&_epoch);
+        }
+#else
+        if (all) {
+            _epoch.notify_all();
+        }
+        else {
+            _epoch.notify_one();
+        }
+#endif
+    }
+};
@@ -0,0 +1,268 @@
+﻿// pipeline.h
+#pragma once
+
+#include "threadsafe_queue.h"
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <map>
+#include <thread>
+#include <utility>
+#include <vector>
+
+// 阶段的执行方式
+enum class stage_mode {
+    serial_in_order,      // 单线程，严格按源阶段产生的顺序处理
+    serial_out_of_order,  // 单线程，按到达顺序处理
+    parallel,             // 多线程并发处理
+};
+
+// 多阶段并行流水线，各阶段之间用 bounded_queue 连接。
+// 源阶段产生的每个数据是一个令牌，同时在途的令牌数不超过 max_tokens，
+// 到达 sink 后归还，所以无论各阶段快慢，内存占用都有上限。
+// 任何阶段抛出异常时，流水线记下第一个异常并关闭所有队列，其它阶段随即退出，
+// run() 汇合全部线程后重新抛出该异常。
+// 用法：
+//   pipeline p(64);
+//   auto lines = p.source<std::string>([&](std::string& out) { return read_line(out); });
+//   auto recs = p.stage<record>(lines, stage_mode::parallel, parse, 4);
+//   p.sink(recs, stage_mode::serial_in_order, [&](record&& r) { aggregate(r); });
+//   p.run();
+class pipeline {
+public:
+    // 阶段之间的连接，元素带上源阶段分配的序号，供 serial_in_order 阶段重排
+    template<typename T>
+    class channel {
+        friend class pipeline;
+        using item = std::pair<std::size_t, T>;
+        std::shared_ptr<bounded_queue<item>> q;
+    };
+
+    explicit pipeline(std::size_t max_tokens) : _max_tokens(max_tokens) {
+        if (max_tokens == 0) {
+            throw std::invalid_argument("pipeline needs at least one token");
+        }
+    }
+    pipeline(const pipeline&) = delete;
+    pipeline& operator=(const pipeline&) = delete;
+
+    // 源阶段：串行调用 gen(T&) 产生数据，返回 false 表示数据结束
+    template<typename T, typename Gen>
+    channel<T> source(Gen gen) {
+        channel<T> out = make_channel<T>();
+        auto q = out.q;
+        _launch.push_back([this, q, gen]() mutable {
+            for (std::size_t seq = 0;; ++seq) {
+                if (!acquire_token()) {
+                    break;
+                }
+                T value;
+                if (!gen(value)) {
+                    release_token();
+                    break;
+                }
+                q->push(std::make_pair(seq, std::move(value)));
+            }
+            q->close();
+            });
+        return out;
+    }
+
+    // 中间阶段：每个数据调用一次 Out fn(In&&)
+    template<typename Out, typename In, typename Fn>
+    channel<Out> stage(channel<In> in, stage_mode mode, Fn fn, std::size_t threads = 1) {
+        channel<Out> out = make_channel<Out>();
+        auto q = out.q;
+        add_workers(in, mode, threads, 1, [q, fn](std::vector<typename channel<In>::item>& items) mutable {
+            for (auto& it : items) {
+                q->push(std::make_pair(it.first, fn(std::move(it.second))));
+            }
+            }, [q]() { q->close(); });
+        return out;
+    }
+
+    // 批处理阶段：一次取最多 batch 个数据，调用 fn(std::vector<In>& in, std::vector<Out>& out)，
+    // fn 必须为每个输入产生一个输出
+    template<typename Out, typename In, typename Fn>
+    channel<Out> batch_stage(channel<In> in, stage_mode mode, std::size_t batch, Fn fn, std::size_t threads = 1) {
+        channel<Out> out = make_channel<Out>();
+        auto q = out.q;
+        add_workers(in, mode, threads, batch, [q, fn](std::vector<typename channel<In>::item>& items) mutable {
+            std::vector<In> inputs;
+            inputs.reserve(items.size());
+            for (auto& it : items) {
+                inputs.push_back(std::move(it.second));
+            }
+            std::vector<Out> outputs;
+            outputs.reserve(items.size());
+            fn(inputs, outputs);
+            if (outputs.size() != items.size()) {
+                throw std::logic_error("batch stage must produce one output per input");
+            }
+            for (std::size_t i = 0; i < items.size(); ++i) {
+                q->push(std::make_pair(items[i].first, std::move(outputs[i])));
+            }
+            }, [q]() { q->close(); });
+        return out;
+    }
+
+    // 末端阶段：处理完一个数据就归还它的令牌
+    template<typename In, typename Fn>
+    void sink(channel<In> in, stage_mode mode, Fn fn, std::size_t threads = 1) {
+        add_workers(in, mode, threads, 1, [this, fn](std::vector<typename channel<In>::item>& items) mutable {
+            for (auto& it : items) {
+                fn(std::move(it.second));
+                release_token();
+            }
+            }, []() {});
+    }
+
+    // 启动所有阶段并等待数据全部流过；每个 pipeline 只能 run 一次。
+    // 某个阶段抛出异常（或者线程创建失败）时，汇合所有线程后在这里重新抛出
+    void run() {
+        std::vector<std::thread> threads;
+        threads.reserve(_launch.size());
+        try {
+            for (auto& fn : _launch) {
+                threads.emplace_back([this, fn = std::move(fn)]() mutable {
+                    try {
+                        fn();
+                    }
+                    catch (...) {
+                        abort();
+                    }
+                    });
+            }
+        }
+        catch (...) {
+            abort();
+        }
+        _launch.clear();
+        for (auto& t : threads) t.join();
+        if (_error) {
+            std::rethrow_exception(_error);
+        }
+    }
+
+    std::size_t max_tokens() const {
+        return _max_tokens;
+    }
+
+private:
+    template<typename T>
+    channel<T> make_channel() {
+        channel<T> ch;
+        // 在途数据不超过令牌数，容量取令牌数即可保证 push 不会长时间阻塞
+        ch.q = std::make_shared<bounded_queue<typename channel<T>::item>>(_max_tokens);
+        auto q = ch.q;
+        _closers.push_back([q]() { q->close(); });
+        return ch;
+    }
+
+    // 为一个阶段登记工作线程，最后一个退出的线程执行 on_done（关闭下游队列）
+    template<typename In, typename Process, typename Done>
+    void add_workers(channel<In> in, stage_mode mode, std::size_t threads, std::size_t batch,
+        Process process, Done on_done) {
+        using item = typename channel<In>::item;
+        if (batch == 0) {
+            throw std::invalid_argument("batch size must be positive");
+        }
+        if (mode != stage_mode::parallel || threads == 0) {
+            threads = 1;
+        }
+        auto q = in.q;
+        auto remaining = std::make_shared<std::atomic<std::size_t>>(threads);
+        auto finish = [remaining, on_done]() mutable {
+            if (remaining->fetch_sub(1) == 1) {
+                on_done();
+            }
+        };
+
+        if (mode == stage_mode::serial_in_order) {
+            _launch.push_back([this, q, batch, process, finish]() mutable {
+                // 重排缓冲：提前到达的数据先放在这里，等前面的序号到齐
+                std::map<std::size_t, In> pending;
+                std::size_t next = 0;
+                std::vector<item> items;
+                item it;
+                while (!aborted() && q->pop(it)) {
+                    pending.emplace(it.first, std::move(it.second));
+                    while (!pending.empty() && pending.begin()->first == next) {
+                        items.clear();
+                        while (!pending.empty() && pending.begin()->first == next && items.size() < batch) {
+                            items.emplace_back(next, std::move(pending.begin()->second));
+                            pending.erase(pending.begin());
+                            ++next;
+                        }
+                        process(items);
+                    }
+                }
+                finish();
+                });
+            return;
+        }
+
+        for (std::size_t i = 0; i < threads; ++i) {
+            _launch.push_back([this, q, batch, process, finish]() mutable {
+                std::vector<item> items;
+                item it;
+                while (!aborted() && q->pop(it)) {
+                    items.clear();
+                    items.push_back(std::move(it));
+                    while (items.size() < batch && q->try_pop(it)) {
+                        items.push_back(std::move(it));
+                    }
+                    process(items);
+                }
+                finish();
+                });
+        }
+    }
+
+    // 流水线已中止时返回 false
+    bool acquire_token() {
+        std::unique_lock<std::mutex> lk(_token_mtx);
+        _token_cv.wait(lk, [this] { return _in_flight < _max_tokens || aborted(); });
+        if (aborted()) {
+            return false;
+        }
+        ++_in_flight;
+        return true;
+    }
+
+    void release_token() {
+        {
+            std::lock_guard<std::mutex> lk(_token_mtx);
+            --_in_flight;
+        }
+        _token_cv.notify_one();
+    }
+
+    bool aborted() const {
+        return _aborted.load(std::memory_order_acquire);
+    }
+
+    // 记下第一个异常，关闭所有队列并唤醒等待令牌的源阶段，让其它阶段尽快退出
+    void abort() {
+        {
+            std::lock_guard<std::mutex> lk(_token_mtx);
+            if (!_error) {
+                _error = std::current_exception();
+            }
+            _aborted.store(true, std::memory_order_release);
+        }
+        _token_cv.notify_all();
+        for (auto& close : _closers) {
+            close();
+        }
+    }
+
+    std::size_t const _max_tokens;
+    std::size_t _in_flight = 0;
+    std::mutex _token_mtx;
+    std::condition_variable _token_cv;
+    std::vector<std::function<void()>> _launch;
+    std::vector<std::function<void()>> _closers;   // 关闭各阶段之间的队列
+    std::atomic<bool> _aborted{ false };
+    std::exception_ptr _error;                     // 受 _token_mtx 保护
+};
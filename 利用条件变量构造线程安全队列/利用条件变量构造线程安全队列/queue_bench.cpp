@@ -0,0 +1,326 @@
+﻿// queue_bench.cpp
+// 对比 bounded_queue 按值 push/pop 与 slot_queue 原地 reserve/commit、peek/release 的吞吐
+#include "threadsafe_queue.h"
+#include "pipeline.h"
+#include <iostream>
+#include <thread>
+#include <chrono>
+#include <cstring>
+#include <cstdint>
+#include <algorithm>
+#include <vector>
+#include <atomic>
+#include <ctime>
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+template<std::size_t N>
+struct message {
+    unsigned char data[N];
+};
+
+// 生产者填充消息，消费者计算校验和，保证两端都真实访问了整条消息
+template<std::size_t N>
+void fill_message(message<N>& msg, std::size_t seq) {
+    std::memset(msg.data, static_cast<int>(seq & 0xff), N);
+}
+
+template<std::size_t N>
+std::uint64_t checksum(const message<N>& msg) {
+    std::uint64_t sum = 0;
+    for (std::size_t i = 0; i < N; i += 64) {
+        sum += msg.data[i];
+    }
+    return sum;
+}
+
+template<typename Fn>
+double measure_ns(Fn&& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto end = std::chrono::steady_clock::now();
+    return static_cast<double>(std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count());
+}
+
+// 按值传递的对照组用同样容量的有界队列，两边只差拷贝还是原地构造，不掺入无界队列的增长
+template<std::size_t N>
+double bench_by_value(std::size_t count, std::size_t capacity) {
+    bounded_queue<message<N>> q(capacity);
+    std::uint64_t sum = 0;
+    double ns = measure_ns([&]() {
+        std::thread consumer([&]() {
+            message<N> msg;
+            for (std::size_t i = 0; i < count; ++i) {
+                if (!q.pop(msg)) {
+                    break;
+                }
+                sum += checksum(msg);
+            }
+            });
+        for (std::size_t i = 0; i < count; ++i) {
+            message<N> msg;
+            fill_message(msg, i);
+            q.push(std::move(msg));
+        }
+        consumer.join();
+        });
+    std::cout << "  checksum " << sum << std::endl;
+    return ns / count;
+}
+
+template<std::size_t N>
+double bench_slot(std::size_t count, std::size_t capacity) {
+    slot_queue<message<N>> q(capacity);
+    std::uint64_t sum = 0;
+    double ns = measure_ns([&]() {
+        std::thread consumer([&]() {
+            for (std::size_t i = 0; i < count; ++i) {
+                const message<N>& msg = q.peek();
+                sum += checksum(msg);
+                q.release(msg);
+            }
+            });
+        for (std::size_t i = 0; i < count; ++i) {
+            message<N>& msg = q.reserve();
+            fill_message(msg, i);
+            q.commit(msg);
+        }
+        consumer.join();
+        });
+    std::cout << "  checksum " << sum << std::endl;
+    return ns / count;
+}
+
+template<std::size_t N>
+double bench_slot_batch(std::size_t count, std::size_t capacity, std::size_t k) {
+    slot_queue<message<N>> q(capacity);
+    std::uint64_t sum = 0;
+    double ns = measure_ns([&]() {
+        std::thread consumer([&]() {
+            for (std::size_t i = 0; i < count; ++i) {
+                const message<N>& msg = q.peek();
+                sum += checksum(msg);
+                q.release(msg);
+            }
+            });
+        for (std::size_t i = 0; i < count; i += k) {
+            std::size_t n = std::min(k, count - i);
+            auto b = q.reserve(n);
+            for (std::size_t j = 0; j < n; ++j) {
+                fill_message(b[j], i + j);
+            }
+            q.commit(b);
+        }
+        consumer.join();
+        });
+    std::cout << "  checksum " << sum << std::endl;
+    return ns / count;
+}
+
+template<std::size_t N>
+void bench_one_size() {
+    // 每种尺寸传输的总字节数大致相同
+    std::size_t const count = std::max<std::size_t>(1000, (std::size_t(64) << 20) / N);
+    std::size_t const capacity = 256;
+    std::size_t const k = 16;
+    double by_value = bench_by_value<N>(count, capacity);
+    double slot = bench_slot<N>(count, capacity);
+    double batch = bench_slot_batch<N>(count, capacity, k);
+    std::cout << "size " << N << " B, msgs " << count
+        << ": by_value " << by_value << " ns/msg"
+        << ", slot " << slot << " ns/msg"
+        << ", slot_batch(" << k << ") " << batch << " ns/msg" << std::endl;
+}
+
+void bench_slot_queue() {
+    bench_one_size<16>();
+    bench_one_size<64>();
+    bench_one_size<256>();
+    bench_one_size<1024>();
+    bench_one_size<4096>();
+    bench_one_size<16384>();
+    bench_one_size<65536>();
+}
+
+// 进程累计 CPU 时间（秒），用于计算空闲时的 CPU 占用
+double process_cpu_seconds() {
+#ifdef __linux__
+    rusage ru{};
+    getrusage(RUSAGE_SELF, &ru);
+    return ru.ru_utime.tv_sec + ru.ru_stime.tv_sec + (ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) / 1e6;
+#else
+    return static_cast<double>(std::clock()) / CLOCKS_PER_SEC;
+#endif
+}
+
+// 条件变量队列，统计每次被唤醒的次数，NotifyAll 为 true 时即为朴素的 notify_all 实现
+template<typename T, bool NotifyAll>
+class counted_cv_queue {
+    std::mutex mut;
+    std::queue<T> data_queue;
+    std::condition_variable data_cond;
+public:
+    std::atomic<std::uint64_t> wakeups{ 0 };
+
+    void push(T new_value) {
+        std::lock_guard<std::mutex> lk(mut);
+        data_queue.push(std::move(new_value));
+        if (NotifyAll)
+            data_cond.notify_all();
+        else
+            data_cond.notify_one();
+    }
+
+    void wait_and_pop(T& value) {
+        std::unique_lock<std::mutex> lk(mut);
+        while (data_queue.empty()) {
+            data_cond.wait(lk);
+            wakeups.fetch_add(1, std::memory_order_relaxed);
+        }
+        value = std::move(data_queue.front());
+        data_queue.pop();
+    }
+};
+
+// 大量消费者大部分时间空闲：生产者每隔一段时间投递一个元素，最后投递 -1 让消费者退出
+template<typename Queue>
+double run_idle_consumers(Queue& q, int consumers, int items) {
+    std::vector<std::thread> threads;
+    for (int i = 0; i < consumers; ++i) {
+        threads.emplace_back([&q]() {
+            int value = 0;
+            for (;;) {
+                q.wait_and_pop(value);
+                if (value < 0)
+                    return;
+            }
+            });
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    double cpu_begin = process_cpu_seconds();
+    auto wall_begin = std::chrono::steady_clock::now();
+    for (int i = 0; i < items; ++i) {
+        q.push(i);
+        std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wall_begin).count();
+    double cpu = process_cpu_seconds() - cpu_begin;
+    for (int i = 0; i < consumers; ++i) {
+        q.push(-1);
+    }
+    for (auto& t : threads) t.join();
+    return cpu / wall * 100.0;
+}
+
+void bench_idle_consumers() {
+    int const consumers = 64;
+    int const items = 2000;
+    {
+        counted_cv_queue<int, true> q;
+        double cpu = run_idle_consumers(q, consumers, items);
+        std::cout << "cv notify_all: wakeups/item " << double(q.wakeups) / items
+            << ", cpu " << cpu << "%" << std::endl;
+    }
+    {
+        counted_cv_queue<int, false> q;
+        double cpu = run_idle_consumers(q, consumers, items);
+        std::cout << "cv notify_one: wakeups/item " << double(q.wakeups) / items
+            << ", cpu " << cpu << "%" << std::endl;
+    }
+    {
+        ec_threadsafe_queue<int> q;
+        double cpu = run_idle_consumers(q, consumers, items);
+        const eventcount& ec = q.events();
+        std::cout << "eventcount: wakeups/item " << double(ec.wakeups()) / items
+            << ", syscalls/item " << double(ec.wait_syscalls() + ec.wake_syscalls()) / items
+            << ", cpu " << cpu << "%" << std::endl;
+    }
+    {
+        // 消费者一直忙碌时，生产者看不到等待者，不会发出唤醒系统调用
+        ec_threadsafe_queue<int> q;
+        int const n = 200000;
+        std::thread consumer([&q, n]() {
+            int value = 0;
+            for (int i = 0; i < n; ++i) q.wait_and_pop(value);
+            });
+        for (int i = 0; i < n; ++i) q.push(i);
+        consumer.join();
+        std::cout << "eventcount busy: wake syscalls/item "
+            << double(q.events().wake_syscalls()) / n << std::endl;
+    }
+}
+
+// 忙等一段时间，模拟阶段的计算开销
+void spin_for(std::chrono::nanoseconds cost) {
+    auto end = std::chrono::steady_clock::now() + cost;
+    while (std::chrono::steady_clock::now() < end) {
+    }
+}
+
+struct pipeline_item {
+    std::chrono::steady_clock::time_point born;
+    std::uint64_t value;
+};
+
+// 三阶段合成负载：parse（并行）→ transform（并行、批处理）→ aggregate（串行按序）
+void run_pipeline(int parse_cost, int transform_cost, int aggregate_cost) {
+    std::size_t const items = 20000;
+    std::size_t const tokens = 64;
+    std::chrono::nanoseconds const unit(1000);
+    unsigned const hw = std::thread::hardware_concurrency();
+    std::size_t const workers = hw != 0 ? hw : 2;
+
+    pipeline p(tokens);
+    std::size_t produced = 0;
+    auto src = p.source<pipeline_item>([&](pipeline_item& out) {
+        if (produced == items) return false;
+        out.born = std::chrono::steady_clock::now();
+        out.value = produced++;
+        return true;
+        });
+    auto parsed = p.stage<pipeline_item>(src, stage_mode::parallel, [=](pipeline_item&& it) {
+        spin_for(unit * parse_cost);
+        it.value *= 3;
+        return it;
+        }, workers);
+    auto transformed = p.batch_stage<pipeline_item>(parsed, stage_mode::parallel, 8,
+        [=](std::vector<pipeline_item>& in, std::vector<pipeline_item>& out) {
+            for (auto& it : in) {
+                spin_for(unit * transform_cost);
+                it.value += 1;
+                out.push_back(it);
+            }
+        }, workers);
+    std::vector<double> latencies;
+    latencies.reserve(items);
+    std::uint64_t sum = 0;
+    std::uint64_t expected = 0;
+    bool ordered = true;
+    p.sink(transformed, stage_mode::serial_in_order, [&](pipeline_item&& it) {
+        spin_for(unit * aggregate_cost);
+        ordered = ordered && it.value == expected * 3 + 1;
+        ++expected;
+        sum += it.value;
+        latencies.push_back(std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - it.born).count());
+        });
+
+    auto start = std::chrono::steady_clock::now();
+    p.run();
+    double sec = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::sort(latencies.begin(), latencies.end());
+    double mean = 0;
+    for (double l : latencies) mean += l;
+    mean /= latencies.size();
+    std::cout << "cost ratio " << parse_cost << ":" << transform_cost << ":" << aggregate_cost
+        << " -> " << items / sec << " items/s, latency mean " << mean << " us, p99 "
+        << latencies[latencies.size() * 99 / 100] << " us" << (ordered ? "" : " (OUT OF ORDER)")
+        << ", sum " << sum << std::endl;
+}
+
+void bench_pipeline() {
+    run_pipeline(1, 1, 1);
+    run_pipeline(4, 1, 1);
+    run_pipeline(1, 4, 1);
+    run_pipeline(1, 1, 4);
+}
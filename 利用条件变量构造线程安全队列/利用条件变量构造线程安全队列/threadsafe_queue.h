@@ -0,0 +1,328 @@
+﻿// threadsafe_queue.h
+#pragma once
+
+#include <mutex>
+#include <condition_variable>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <cassert>
+#include <cstddef>
+#include <stdexcept>
+#include "../../common/eventcount.h"
+
+// 利用条件变量实现的线程安全队列，消费者在队列为空时挂起等待，而不是像 PoorImpleman 那样睡眠轮询
+template<typename T>
+class threadsafe_queue {
+private:
+    mutable std::mutex mut;
+    std::queue<T> data_queue;
+    std::condition_variable data_cond;
+public:
+    threadsafe_queue() {}
+    threadsafe_queue(const threadsafe_queue&) = delete;
+    threadsafe_queue& operator=(const threadsafe_queue&) = delete;
+
+    void push(T new_value) {
+        std::lock_guard<std::mutex> lk(mut);
+        data_queue.push(std::move(new_value));
+        data_cond.notify_one();
+    }
+
+    // 阻塞直到有数据，结果通过引用带出
+    void wait_and_pop(T& value) {
+        std::unique_lock<std::mutex> lk(mut);
+        data_cond.wait(lk, [this] { return !data_queue.empty(); });
+        value = std::move(data_queue.front());
+        data_queue.pop();
+    }
+
+    std::shared_ptr<T> wait_and_pop() {
+        std::unique_lock<std::mutex> lk(mut);
+        data_cond.wait(lk, [this] { return !data_queue.empty(); });
+        std::shared_ptr<T> res(std::make_shared<T>(std::move(data_queue.front())));
+        data_queue.pop();
+        return res;
+    }
+
+    bool try_pop(T& value) {
+        std::lock_guard<std::mutex> lk(mut);
+        if (data_queue.empty())
+            return false;
+        value = std::move(data_queue.front());
+        data_queue.pop();
+        return true;
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lk(mut);
+        return data_queue.empty();
+    }
+};
+
+// 有容量上限、可以关闭的队列，用于连接流水线各阶段：
+// 队列满时 push 阻塞，形成反压；close 之后消费者取完剩余数据，pop 返回 false
+template<typename T>
+class bounded_queue {
+private:
+    mutable std::mutex mut;
+    std::queue<T> data_queue;
+    std::condition_variable not_empty;
+    std::condition_variable not_full;
+    std::size_t const capacity;
+    bool closed = false;
+public:
+    explicit bounded_queue(std::size_t cap) : capacity(cap) {
+        if (cap == 0) {
+            throw std::invalid_argument("bounded_queue capacity must be positive");
+        }
+    }
+    bounded_queue(const bounded_queue&) = delete;
+    bounded_queue& operator=(const bounded_queue&) = delete;
+
+    void push(T new_value) {
+        {
+            std::unique_lock<std::mutex> lk(mut);
+            not_full.wait(lk, [this] { return data_queue.size() < capacity || closed; });
+            if (closed) {
+                throw std::logic_error("push to closed bounded_queue");
+            }
+            data_queue.push(std::move(new_value));
+        }
+        not_empty.notify_one();
+    }
+
+    // 阻塞直到取到数据；队列已关闭且为空时返回 false
+    bool pop(T& value) {
+        {
+            std::unique_lock<std::mutex> lk(mut);
+            not_empty.wait(lk, [this] { return !data_queue.empty() || closed; });
+            if (data_queue.empty()) {
+                return false;
+            }
+            value = std::move(data_queue.front());
+            data_queue.pop();
+        }
+        not_full.notify_one();
+        return true;
+    }
+
+    bool try_pop(T& value) {
+        {
+            std::lock_guard<std::mutex> lk(mut);
+            if (data_queue.empty())
+                return false;
+            value = std::move(data_queue.front());
+            data_queue.pop();
+        }
+        not_full.notify_one();
+        return true;
+    }
+
+    void close() {
+        {
+            std::lock_guard<std::mutex> lk(mut);
+            closed = true;
+        }
+        not_empty.notify_all();
+        not_full.notify_all();
+    }
+};
+
+// 与 threadsafe_queue 接口相同，但用 eventcount 阻塞消费者：
+// 没有消费者在等待时 push 不做任何系统调用，notify_one 也只唤醒一个消费者
+template<typename T>
+class ec_threadsafe_queue {
+private:
+    mutable std::mutex mut;
+    std::queue<T> data_queue;
+    eventcount ec;
+public:
+    ec_threadsafe_queue() {}
+    ec_threadsafe_queue(const ec_threadsafe_queue&) = delete;
+    ec_threadsafe_queue& operator=(const ec_threadsafe_queue&) = delete;
+
+    void push(T new_value) {
+        {
+            std::lock_guard<std::mutex> lk(mut);
+            data_queue.push(std::move(new_value));
+        }
+        // 在锁外唤醒，被唤醒的消费者不必再等待这把锁
+        ec.notify_one();
+    }
+
+    void wait_and_pop(T& value) {
+        while (!try_pop(value)) {
+            eventcount::key_type key = ec.prepare_wait();
+            if (try_pop(value)) {
+                ec.cancel_wait();
+                return;
+            }
+            ec.commit_wait(key);
+        }
+    }
+
+    bool try_pop(T& value) {
+        std::lock_guard<std::mutex> lk(mut);
+        if (data_queue.empty())
+            return false;
+        value = std::move(data_queue.front());
+        data_queue.pop();
+        return true;
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lk(mut);
+        return data_queue.empty();
+    }
+
+    // 基准测试用于读取统计数据
+    const eventcount& events() const { return ec; }
+};
+
+// 基于预分配槽位数组的队列，生产者直接在槽位里构造数据，消费者直接在槽位里读取，
+// 省掉 push/pop 按值传递时进出容器的两次拷贝（对几 KB 的大消息很明显）。
+// 互斥量只保护下标和槽位状态，填充和读取槽位内容都在锁外完成。
+// 用法：
+//   T& s = q.reserve();  /* 原地填充 s */  q.commit(s);
+//   const T& r = q.peek(); /* 原地读取 r */ q.release(r);
+template<typename T>
+class slot_queue {
+private:
+    enum class slot_state { free, writing, ready, reading };
+
+    std::vector<T> _slots;
+    std::vector<slot_state> _states;
+    std::size_t const _capacity;
+    std::size_t _head = 0;   // 最早一个还未 release 的位置
+    std::size_t _read = 0;   // 下一个要 peek 的位置
+    std::size_t _write = 0;  // 下一个要 reserve 的位置
+    mutable std::mutex _mtx;
+    std::condition_variable _not_full;
+    std::condition_variable _not_empty;
+    std::size_t _waiting_consumers = 0;  // 阻塞在 peek 中的消费者数，受 _mtx 保护
+
+    std::size_t index_of(const T& s) const {
+        std::size_t idx = static_cast<std::size_t>(&s - _slots.data());
+        if (idx >= _capacity) {
+            throw std::logic_error("slot does not belong to this queue");
+        }
+        return idx;
+    }
+
+    // 调用者需持有锁：释放位置连续回收后才能唤醒生产者
+    void advance_head() {
+        bool advanced = false;
+        while (_head != _read && _states[_head % _capacity] == slot_state::free) {
+            ++_head;
+            advanced = true;
+        }
+        if (advanced) {
+            _not_full.notify_all();
+        }
+    }
+
+public:
+    // 一次 reserve 出来的连续 K 个槽位（环形数组中可能跨越末尾）
+    class batch {
+        friend class slot_queue;
+        slot_queue* _q;
+        std::size_t _first;
+        std::size_t _count;
+        batch(slot_queue* q, std::size_t first, std::size_t count) : _q(q), _first(first), _count(count) {}
+    public:
+        std::size_t size() const { return _count; }
+        T& operator[](std::size_t i) {
+            assert(i < _count && "batch index out of range");
+            return _q->_slots[(_first + i) % _q->_capacity];
+        }
+    };
+
+    explicit slot_queue(std::size_t capacity) :
+        _slots(capacity), _states(capacity, slot_state::free), _capacity(capacity) {
+        if (capacity == 0) {
+            throw std::invalid_argument("slot_queue capacity must be positive");
+        }
+    }
+    slot_queue(const slot_queue&) = delete;
+    slot_queue& operator=(const slot_queue&) = delete;
+
+    std::size_t capacity() const { return _capacity; }
+
+    // 生产者：申请一个空闲槽位，队列满时阻塞
+    T& reserve() {
+        std::unique_lock<std::mutex> lk(_mtx);
+        _not_full.wait(lk, [this] { return _write - _head < _capacity; });
+        std::size_t idx = _write++ % _capacity;
+        _states[idx] = slot_state::writing;
+        return _slots[idx];
+    }
+
+    // 生产者：一次申请 k 个连续槽位，减少加锁次数
+    batch reserve(std::size_t k) {
+        if (k == 0 || k > _capacity) {
+            throw std::invalid_argument("batch size must be in [1, capacity]");
+        }
+        std::unique_lock<std::mutex> lk(_mtx);
+        _not_full.wait(lk, [this, k] { return _write - _head + k <= _capacity; });
+        std::size_t first = _write % _capacity;
+        for (std::size_t i = 0; i < k; ++i) {
+            _states[(first + i) % _capacity] = slot_state::writing;
+        }
+        _write += k;
+        return batch(this, first, k);
+    }
+
+    // 生产者：槽位填充完毕，对消费者可见
+    void commit(T& s) {
+        std::size_t idx = index_of(s);
+        std::lock_guard<std::mutex> lk(_mtx);
+        _states[idx] = slot_state::ready;
+        // 消费者只会等待 _read 所在的槽位，其它位置提交时无需唤醒
+        if (idx == _read % _capacity) {
+            _not_empty.notify_one();
+        }
+    }
+
+    void commit(batch& b) {
+        std::lock_guard<std::mutex> lk(_mtx);
+        for (std::size_t i = 0; i < b._count; ++i) {
+            _states[(b._first + i) % _capacity] = slot_state::ready;
+        }
+        // 每个新就绪的槽位最多唤醒一个消费者，且不超过正在等待的人数，避免惊群
+        std::size_t wake = b._count < _waiting_consumers ? b._count : _waiting_consumers;
+        for (std::size_t i = 0; i < wake; ++i) {
+            _not_empty.notify_one();
+        }
+    }
+
+    // 消费者：按提交顺序取出下一个槽位的只读引用，没有数据时阻塞
+    const T& peek() {
+        std::unique_lock<std::mutex> lk(_mtx);
+        ++_waiting_consumers;
+        _not_empty.wait(lk, [this] {
+            return _read != _write && _states[_read % _capacity] == slot_state::ready;
+            });
+        --_waiting_consumers;
+        std::size_t idx = _read++ % _capacity;
+        _states[idx] = slot_state::reading;
+        // 后续槽位也已就绪时，把唤醒传递给下一个等待的消费者
+        if (_read != _write && _states[_read % _capacity] == slot_state::ready) {
+            _not_empty.notify_one();
+        }
+        return _slots[idx];
+    }
+
+    // 消费者：读取完毕，归还槽位供生产者复用
+    void release(const T& s) {
+        std::size_t idx = index_of(s);
+        std::lock_guard<std::mutex> lk(_mtx);
+        _states[idx] = slot_state::free;
+        advance_head();
+    }
+
+    bool empty() const {
+        std::lock_guard<std::mutex> lk(_mtx);
+        return _read == _write || _states[_read % _capacity] != slot_state::ready;
+    }
+};
@@ -2,6 +2,7 @@
 #include <thread>
 #include <mutex>
 #include <chrono>
+#include <cstring>
 
 std::mutex mtx_num;
 int num = 1;  // ʼֵΪ1Ա߳Aȴӡ
@@ -39,7 +40,33 @@ void PoorImpleman() {
     t2.join();
 }
 
-int main() {
-    PoorImpleman();
-    return 0;
+void bench_slot_queue();
+void bench_idle_consumers();
+void bench_pipeline();
+
+// ͨвѡʾʱ PoorImpleman
+struct demo_entry {
+    const char* name;
+    void (*fn)();
+};
+
+int main(int argc, char* argv[]) {
+    demo_entry const demos[] = {
+        { "PoorImpleman", PoorImpleman },
+        { "bench_slot_queue", bench_slot_queue },
+        { "bench_idle_consumers", bench_idle_consumers },
+        { "bench_pipeline", bench_pipeline },
+    };
+    const char* which = argc > 1 ? argv[1] : "PoorImpleman";
+    for (const auto& demo : demos) {
+        if (std::strcmp(demo.name, which) == 0) {
+            demo.fn();
+            return 0;
+        }
+    }
+    std::cerr << "unknown demo " << which << ", available:" << std::endl;
+    for (const auto& demo : demos) {
+        std::cerr << "  " << demo.name << std::endl;
+    }
+    return 1;
 }